@@ -5,19 +5,19 @@
 #include "Cluster.h"
 #include "common.h"
 
-double Cluster::allMeanDis = 0;
-
 /**
  * 向聚类中添加点
  * @param p_index 点的id
+ * @param w 点的权重
  */
-void Cluster::add_point(int p_index) {
+void Cluster::add_point(int p_index, double w) {
     if (ids.find(static_cast<const unsigned int &>(p_index)) != ids.end())
     {
         cout << WARN_POINT_REPEAT << endl;
         return;
     }
     ids.emplace(p_index);
+    weight += w;
 }
 
 
@@ -28,4 +28,5 @@ void Cluster::add_point(int p_index) {
  */
 void Cluster::clear_ids() {
     ids.clear();
+    weight = 0;
 }
@@ -7,20 +7,35 @@
 
 #include <vector>
 #include <unordered_set>
+#include <memory_resource>
 
 using namespace std;
 
+/**
+ * 聚类的充分统计量，增量更新时使用
+ */
+struct cluster_stats{
+    double weight; // 样本权重之和
+    vector<double> sum; // 各维的加权和
+    vector<double> sumsq; // 各维的加权平方和
+    double dissum; // 样本到中心的加权距离之和，中心增量移动后为近似值
+    double baseline; // 上次调整后 innerMeanDis 与 allMeanDis 之比
+    cluster_stats(): weight(0), sum(), sumsq(), dissum(0), baseline(0) {}
+};
+
 struct Cluster{
     double innerMeanDis; // 类内平均距离
     vector<double> sigma; // 每个聚类的标准差
-    static double allMeanDis; // 总体平均距离
     vector<double> center; // 聚类中心位置的
-    unordered_set<unsigned> ids; // 从属于此聚类的样本的id，位于isodata的data中的
+    double sqnorm; // 聚类中心的平方范数，稀疏数据计算距离时使用
+    pmr::unordered_set<unsigned> ids; // 从属于此聚类的样本的id，位于isodata的data中的，节点从isodata的内存池中分配
+    cluster_stats stats; // 充分统计量，只在增量模式下维护
+    double weight; // 样本的权重之和，由add_point与clear_ids维护
     Cluster():
-        center{}, innerMeanDis(0), sigma(vector<double>{}){}
-    explicit Cluster(vector<double> &c):
-        center(c), innerMeanDis(0), sigma(vector<double>(c.size(), 0)) {}
-    void add_point(int p_index);
+        innerMeanDis(0), sigma(vector<double>{}), center{}, sqnorm(0), weight(0){}
+    explicit Cluster(vector<double> &c, pmr::memory_resource *mr = pmr::get_default_resource()):
+        innerMeanDis(0), sigma(vector<double>(c.size(), 0)), center(c), sqnorm(0), ids(mr), weight(0) {}
+    void add_point(int p_index, double w = 1.0);
     void clear_ids();
 };
 
@@ -0,0 +1,60 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 计数构建：替换全局的operator new/delete，统计申请次数到heap_allocs
+// 只链接到需要统计全部堆内存申请的程序(如测试)中，不放进库里
+
+#include "arena.h"
+#include <cstdlib>
+#include <new>
+
+static bool enable_counting = (heap_counting = true);
+
+void *operator new(size_t n)
+{
+    ++heap_allocs;
+    if (void *p = malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void *operator new(size_t n, const std::nothrow_t &) noexcept
+{
+    ++heap_allocs;
+    return malloc(n ? n : 1);
+}
+
+void *operator new[](size_t n, const std::nothrow_t &) noexcept
+{
+    return operator new(n, std::nothrow);
+}
+
+void *operator new(size_t n, std::align_val_t align)
+{
+    ++heap_allocs;
+    auto a = static_cast<size_t>(align);
+    // aligned_alloc要求大小是对齐的整数倍
+    if (void *p = aligned_alloc(a, (n + a - 1) / a * a))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t n, std::align_val_t align)
+{
+    return operator new(n, align);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { free(p); }
@@ -0,0 +1,90 @@
+//
+// Created by Jeff on 2019/1/21 0021.
+//
+
+#include "arena.h"
+#include <cstdint>
+#include <algorithm>
+
+std::atomic<unsigned long long> heap_allocs(0);
+bool heap_counting = false;
+
+void *counting_resource::do_allocate(size_t n, size_t align) {
+    ++allocs;
+    bytes += n;
+    used += n;
+    peak = max(peak, used);
+    return upstream->allocate(n, align);
+}
+
+void counting_resource::do_deallocate(void *p, size_t n, size_t align) {
+    used -= n;
+    upstream->deallocate(p, n, align);
+}
+
+bool counting_resource::do_is_equal(const pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+iter_arena::iter_arena(pmr::memory_resource *up, size_t chunk_size) :
+        upstream(up), chunk_size(chunk_size), chunks(), cur(0), ptr(nullptr), end(nullptr) {
+}
+
+iter_arena::~iter_arena() {
+    for (auto &c : chunks)
+        upstream->deallocate(c.p, c.size, alignof(max_align_t));
+}
+
+/**
+ * 回收本次迭代的全部内存，只重置指针
+ */
+void iter_arena::reset() {
+    cur = 0;
+    ptr = chunks.empty() ? nullptr : chunks[0].p;
+    end = chunks.empty() ? nullptr : chunks[0].p + chunks[0].size;
+}
+
+/**
+ * 已申请的内存总量
+ */
+size_t iter_arena::capacity() const {
+    size_t res(0);
+    for (auto &c : chunks)
+        res += c.size;
+    return res;
+}
+
+void *iter_arena::do_allocate(size_t n, size_t align) {
+    auto aligned = [&]() {
+        auto p = reinterpret_cast<uintptr_t>(ptr);
+        return reinterpret_cast<char *>((p + align - 1) & ~(static_cast<uintptr_t>(align) - 1));
+    };
+    if (ptr == nullptr || aligned() + n > end)
+    {
+        next_chunk(n + align);
+    }
+    auto p = aligned();
+    ptr = p + n;
+    return p;
+}
+
+/**
+ * 切换到下一个足够大的内存块，后面没有可用的内存块时才向上游申请
+ * 新内存块插在当前块之后，reset()之后按同样的顺序复用
+ */
+void iter_arena::next_chunk(size_t n) {
+    size_t next = chunks.empty() ? 0 : cur + 1;
+    if (next >= chunks.size() || chunks[next].size < n)
+    {
+        auto size = chunk_size;
+        if (!chunks.empty())
+            size = max(size, chunks.back().size * 2);
+        while (size < n)
+            size *= 2;
+        chunk c{static_cast<char *>(upstream->allocate(size, alignof(max_align_t))), size};
+        chunks.insert(chunks.begin() + static_cast<ptrdiff_t>(next), c);
+    }
+    cur = next;
+    ptr = chunks[cur].p;
+    end = ptr + chunks[cur].size;
+}
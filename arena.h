@@ -0,0 +1,111 @@
+//
+// Created by Jeff on 2019/1/21 0021.
+//
+
+#ifndef ISODATA_ARENA_H
+#define ISODATA_ARENA_H
+
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+/**
+ * 统计向上游申请内存次数的内存资源
+ * 用作arena和内存池的上游，计数在稳定迭代中不再增长即说明没有新的系统内存分配
+ */
+class counting_resource : public pmr::memory_resource {
+public:
+    explicit counting_resource(pmr::memory_resource *up = pmr::new_delete_resource()) :
+            upstream(up), allocs(0), bytes(0), used(0), peak(0) {}
+    unsigned long long count() const { return allocs; }
+    unsigned long long total_bytes() const { return bytes; }
+    size_t in_use() const { return used; }
+    size_t peak_bytes() const { return peak; }
+
+private:
+    void *do_allocate(size_t n, size_t align) override;
+    void do_deallocate(void *p, size_t n, size_t align) override;
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override;
+
+    pmr::memory_resource *upstream;
+    unsigned long long allocs; // 分配次数
+    unsigned long long bytes; // 累计分配的字节数
+    size_t used; // 尚未释放的字节数
+    size_t peak; // used的最大值
+};
+
+/**
+ * 内存统计的类别
+ */
+enum memory_category {
+    MEM_SAMPLES, // 样本，包括量化、NUMA分片等样本的副本
+    MEM_MEMBERSHIP, // 聚类中样本id集合
+    MEM_CENTERS, // 聚类中心、标准差与充分统计量
+    MEM_SCRATCH, // 迭代内的临时数据与输出时的缓冲
+    MEM_CATEGORIES
+};
+
+/**
+ * 按类别统计的内存字节数与峰值
+ */
+struct memory_usage {
+    size_t current[MEM_CATEGORIES];
+    size_t peak[MEM_CATEGORIES];
+    size_t total; // 各类别之和
+    size_t total_peak; // total的最大值
+    memory_usage() : current(), peak(), total(0), total_peak(0) {}
+    void set(memory_category c, size_t bytes)
+    {
+        total = total - current[c] + bytes;
+        current[c] = bytes;
+        peak[c] = max(peak[c], bytes);
+        total_peak = max(total_peak, total);
+    }
+};
+
+/**
+ * 单次迭代内使用的arena
+ * 分配只移动指针，释放不做任何事，迭代结束时reset()在O(1)时间内回收全部内存，
+ * 已申请的内存块保留下来给后续迭代复用，因此稳定之后不再向上游申请内存
+ */
+class iter_arena : public pmr::memory_resource {
+public:
+    explicit iter_arena(pmr::memory_resource *up = pmr::new_delete_resource(), size_t chunk_size = 64 * 1024);
+    iter_arena(const iter_arena &) = delete;
+    iter_arena &operator=(const iter_arena &) = delete;
+    ~iter_arena() override;
+    void reset();
+    size_t capacity() const;
+
+private:
+    struct chunk {
+        char *p;
+        size_t size;
+    };
+    void *do_allocate(size_t n, size_t align) override;
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override { return this == &other; }
+    void next_chunk(size_t n);
+
+    pmr::memory_resource *upstream;
+    size_t chunk_size; // 新内存块的最小大小
+    vector<chunk> chunks; // 已申请的内存块
+    size_t cur; // 当前使用的内存块
+    char *ptr; // 当前内存块中的空闲位置
+    char *end; // 当前内存块的末尾
+};
+
+
+/**
+ * 全局operator new的调用次数(含所有线程)
+ * 只在链接了alloc_count.cpp的计数构建中统计，heap_counting为true；其他构建中始终为0
+ */
+extern std::atomic<unsigned long long> heap_allocs;
+extern bool heap_counting;
+
+
+#endif //ISODATA_ARENA_H
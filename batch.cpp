@@ -0,0 +1,100 @@
+//
+// Created by Jeff on 2019/1/31 0031.
+//
+
+#include "batch.h"
+#include "isodata.h"
+#include "error.h"
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+batch_runner::batch_runner(unsigned c, unsigned _nc, unsigned _tn, double _te, double _tc,
+                           unsigned _nt, unsigned _ns, unsigned threads) :
+        _c(c), _nc(_nc), _tn(_tn), _te(_te), _tc(_tc), _nt(_nt), _ns(_ns),
+        values(), offsets(), rows(), cols(), seed(0), fixed_seed(false), sched(threads), pools(), out() {
+    pmr::pool_options opt;
+    // iter_arena的64K内存块也由内存池管理
+    opt.largest_required_pool_block = 1 << 20;
+    for (unsigned w = 0; w < sched.size(); ++w)
+        pools.emplace_back(new pmr::unsynchronized_pool_resource(opt));
+}
+
+/**
+ * 加入一个数据集，样本拷贝到连续内存的末尾
+ * 各行维数不一致、样本数少于_c或_tn、互不相同的样本少于_nc(无法选出初始中心)的数据集不加入
+ * @return 是否加入，不加入的数据集不占用序号
+ */
+bool batch_runner::add(const vector<vector<double>> &dataset) {
+    const auto width = dataset.empty() ? 0 : dataset[0].size();
+    for (auto &line : dataset) {
+        if (line.size() != width)
+        {
+            cout << WARN_DATA_SIZE << endl;
+            return false;
+        }
+    }
+    if (dataset.size() < _c || dataset.size() < _tn)
+    {
+        cout << WARN_DATA_SIZE << endl;
+        return false;
+    }
+    vector<const vector<double> *> sorted;
+    sorted.reserve(dataset.size());
+    for (auto &line : dataset)
+        sorted.push_back(&line);
+    sort(sorted.begin(), sorted.end(), [](const vector<double> *a, const vector<double> *b) { return *a < *b; });
+    unsigned distinct(0);
+    for (size_t i = 0; i < sorted.size() && distinct < _nc; ++i) {
+        if (i == 0 || *sorted[i] != *sorted[i - 1])
+            ++distinct;
+    }
+    if (distinct < _nc)
+    {
+        cout << WARN_POINT_REPEAT << endl;
+        return false;
+    }
+    offsets.push_back(values.size());
+    rows.push_back(static_cast<unsigned>(dataset.size()));
+    cols.push_back(dataset.empty() ? 0 : static_cast<unsigned>(dataset[0].size()));
+    for (auto &line : dataset)
+        values.insert(values.end(), line.begin(), line.end());
+    return true;
+}
+
+/**
+ * 运行全部数据集，每个数据集结束后调用on_result
+ */
+void batch_runner::run(const CALLBACK &on_result) {
+    output_config cfg;
+    cfg.formats = 0;
+    cfg.print = false;
+    cfg.summary = false;
+    sched.parallel_for("batch", rows.size(), 1, [&](size_t begin, size_t end, unsigned w) {
+        for (auto i = begin; i < end; ++i) {
+            auto start = chrono::steady_clock::now();
+            batch_result res;
+            {
+                // 单个运行在本线程内完成，不再开线程；样本直接从values中读取，不拷贝
+                isodata iso(_c, _nc, _tn, _te, _tc, _nt, _ns, [] { return vector<vector<double>>(); }, pools[w].get());
+                iso.set_rows(values.data() + offsets[i], rows[i], cols[i]);
+                iso.set_output(cfg);
+                if (fixed_seed)
+                    iso.set_seed(seed + static_cast<unsigned>(i));
+                iso.run();
+                res.index = i;
+                res.rows = rows[i];
+                res.cols = cols[i];
+                for (auto &cluster : iso.get_clusters()) {
+                    res.centers.push_back(cluster.center);
+                    res.sizes.push_back(cluster.ids.size());
+                }
+                res.labels = iso.labels();
+                res.all_mean_dis = iso.mean_distance();
+            }
+            res.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            lock_guard<mutex> lk(out);
+            on_result(res);
+        }
+    });
+}
@@ -0,0 +1,69 @@
+//
+// Created by Jeff on 2019/1/31 0031.
+//
+
+#ifndef ISODATA_BATCH_H
+#define ISODATA_BATCH_H
+
+#include <vector>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include "scheduler.h"
+
+using namespace std;
+
+/**
+ * 一次运行的结果
+ */
+struct batch_result {
+    size_t index; // 数据集的序号，即add的顺序
+    unsigned rows; // 样本个数
+    unsigned cols; // 特征个数
+    vector<vector<double>> centers; // 各聚类中心
+    vector<size_t> sizes; // 各聚类的样本数
+    vector<int32_t> labels; // 每个样本所属聚类的编号，从1开始
+    double all_mean_dis; // 总体平均距离
+    double ms; // 运行时间，毫秒
+};
+
+/**
+ * 批量聚类大量小数据集
+ * 全部数据集紧凑地存放在同一块连续内存中，各次运行直接读取其中的样本，不另外拷贝；各数据集是独立的ISODATA运行，
+ * 由一个工作窃取的调度器分配到各线程；每个线程有自己的内存池，
+ * 该线程上先后运行的isodata都从这个内存池申请内存，前面的运行释放的内存被后面的运行复用。
+ * 每次运行结束就调用回调输出结果，回调串行执行，不需要线程安全
+ */
+class batch_runner {
+public:
+    typedef function<void(const batch_result &)> CALLBACK;
+    /**
+     * 构造函数，参数含义与isodata相同，所有数据集使用相同的参数
+     * @param threads 线程数，0表示每个CPU一个线程
+     */
+    batch_runner(unsigned c, unsigned _nc, unsigned _tn, double _te, double _tc,
+                 unsigned _nt, unsigned _ns, unsigned threads = 0);
+    bool add(const vector<vector<double>> &dataset);
+    size_t size() const { return rows.size(); }
+    void set_seed(unsigned s) { seed = s; fixed_seed = true; }
+    void run(const CALLBACK &on_result);
+    const map<string, phase_timing> &timings() const { return sched.timings(); }
+
+private:
+    unsigned _c, _nc, _tn;
+    double _te, _tc;
+    unsigned _nt, _ns;
+    vector<double> values; // 全部数据集的样本，按行连续存放
+    vector<size_t> offsets; // 每个数据集在values中的起始位置
+    vector<unsigned> rows; // 每个数据集的行数
+    vector<unsigned> cols; // 每个数据集的列数
+    unsigned seed; // 随机数种子，第i个数据集使用seed+i
+    bool fixed_seed;
+    task_scheduler sched;
+    vector<unique_ptr<pmr::unsynchronized_pool_resource>> pools; // 每个线程一个内存池
+    mutex out; // 串行化回调
+};
+
+
+#endif //ISODATA_BATCH_H
@@ -0,0 +1,232 @@
+//
+// Created by Jeff on 2019/2/2 0002.
+//
+
+/**
+ * 性能回归测试
+ * 在一组可复现的合成负载上完整运行isodata，记录吞吐量、各阶段耗时、峰值内存与准确率，
+ * 写入JSON；给出基准文件时与之比较(比较的各项见report.cpp的compare)，任一负载超出容差则返回1。
+ * 每个负载在单独的子进程中运行，峰值内存互不影响。
+ *
+ * 编译：cmake的isodata_bench目标
+ * 用法：isodata_bench [--out result.json] [--baseline base.json] [--tolerance 0.1]
+ *                     [--rss-tolerance 0.1] [--threads 1] [--scale 1] [--only name] [--repeat 1]
+ *                     [--timing 0]
+ *
+ * 参考基准bench/baseline.json以 --repeat 3 生成，bench_check目标用它比较与机器无关的各项
+ * (收敛的迭代次数、聚类个数、准确率、峰值内存)。
+ * 耗时与机器有关，--timing 1 时才比较，基准必须是在同一台机器上用同样的参数生成的；
+ * bench_baseline目标在构建目录中生成这样的基准，bench_check_timing目标与之比较。
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../isodata.h"
+#include "workload.h"
+#include "report.h"
+
+/**
+ * 在当前进程中运行一个负载
+ */
+static bench_result run_workload(const workload &w, unsigned threads)
+{
+    vector<vector<double>> dense;
+    csr_matrix sdata;
+    vector<unsigned> truth;
+    if (w.kind == WL_SPARSE)
+        sdata = generate_sparse(w, &truth);
+    else
+        dense = generate_dense(w, &truth);
+    // 类内标准差随样本数的平方根增长，上限按期望的类大小设置，避免过度分裂；
+    // 拉长的聚类某些维的标准差最多为4倍(平行的细长团为8倍)
+    const double stretch = w.kind == WL_ANISOTROPIC ? 4 : w.kind == WL_PARALLEL ? 8 : 1;
+    const double te = w.spread * stretch * sqrt(static_cast<double>(w.rows) / w.k) * 2;
+    const unsigned tn = max(w.rows / (w.k * 20), 1u);
+    // 稠密数据的类中心相距约8倍类内标准差，合并阈值取2倍标准差；稀疏数据的类中心只在各自的常用列上
+    // 非零，相距远小于此，合并阈值取类中心期望距离的一半，见workload.cpp的center_gap
+    const double tc = w.kind == WL_SPARSE ? center_gap(w) / 2 : w.spread * 2;
+    isodata iso(w.k, w.k, tn, te, tc, 2, w.iterations, [&dense]() { return std::move(dense); });
+    if (w.kind == WL_SPARSE)
+        iso.set_sparse_source([&sdata]() { return std::move(sdata); });
+    output_config out;
+    out.formats = 0;
+    out.print = false;
+    out.summary = false;
+    iso.set_output(out);
+    iso.set_seed(w.seed);
+    iso.set_threads(threads);
+    iso.set_deterministic(w.deterministic);
+    if (w.diagonal)
+        iso.set_metric(METRIC_DIAGONAL);
+    if (w.numa)
+    {
+        numa_config cfg;
+        cfg.enabled = true;
+        cfg.threads = threads;
+        iso.set_numa(cfg);
+    }
+    auto start = chrono::steady_clock::now();
+    iso.run();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bench_result r{};
+    r.name = w.name;
+    r.rows = w.rows;
+    r.cols = w.cols;
+    r.iterations = w.iterations;
+    r.converged = iso.iterations_to_converge();
+    r.clusters = static_cast<unsigned>(iso.get_clusters().size());
+    r.accuracy = accuracy(iso.labels(), truth);
+    r.seconds = seconds;
+    r.throughput = seconds > 0 ? static_cast<double>(w.rows) * w.iterations / seconds : 0;
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    r.peak_rss_kb = usage.ru_maxrss;
+    for (auto &p : iso.phase_timings())
+        r.phases[p.first] = phase_result{p.second.calls, p.second.wall, p.second.idle};
+    return r;
+}
+
+/**
+ * 在子进程中运行，结果以JSON经管道传回
+ * @return 子进程是否正常结束
+ */
+static bool run_isolated(const workload &w, unsigned threads, bench_result &res)
+{
+    int fd[2];
+    if (pipe(fd) != 0)
+        return false;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fd[0]);
+        close(fd[1]);
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(fd[0]);
+        auto text = to_json({run_workload(w, threads)});
+        size_t done = 0;
+        while (done < text.size()) {
+            auto n = write(fd[1], text.data() + done, text.size() - done);
+            if (n <= 0)
+                _exit(1);
+            done += static_cast<size_t>(n);
+        }
+        close(fd[1]);
+        _exit(0);
+    }
+    close(fd[1]);
+    string text;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd[0], buf, sizeof(buf))) > 0)
+        text.append(buf, static_cast<size_t>(n));
+    close(fd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    vector<bench_result> parsed;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !from_json(text, parsed) || parsed.size() != 1)
+        return false;
+    res = parsed[0];
+    return true;
+}
+
+static bool read_file(const string &path, string &text)
+{
+    ifstream in(path);
+    if (!in)
+        return false;
+    stringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    string out_path("bench_result.json"), baseline_path, only;
+    double tolerance(0.1), rss_tolerance(0.1), scale(1);
+    unsigned threads(1), repeat(1);
+    bool timing(false);
+    for (int i = 1; i < argc; ++i) {
+        string arg(argv[i]);
+        if (i + 1 >= argc)
+        {
+            cerr << "missing value for " << arg << endl;
+            return 2;
+        }
+        string value(argv[++i]);
+        if (arg == "--out")
+            out_path = value;
+        else if (arg == "--baseline")
+            baseline_path = value;
+        else if (arg == "--tolerance")
+            tolerance = stod(value);
+        else if (arg == "--rss-tolerance")
+            rss_tolerance = stod(value);
+        else if (arg == "--threads")
+            threads = static_cast<unsigned>(stoul(value));
+        else if (arg == "--scale")
+            scale = stod(value);
+        else if (arg == "--only")
+            only = value;
+        else if (arg == "--repeat")
+            repeat = max(static_cast<unsigned>(stoul(value)), 1u);
+        else if (arg == "--timing")
+            timing = stoul(value) != 0;
+        else
+        {
+            cerr << "unknown option " << arg << endl;
+            return 2;
+        }
+    }
+
+    vector<bench_result> results;
+    for (auto &w : default_workloads(scale)) {
+        if (!only.empty() && w.name != only)
+            continue;
+        // 重复多次取耗时最短的一次，减小噪声
+        bench_result best{};
+        bool ok = false;
+        for (unsigned t = 0; t < repeat; ++t) {
+            bench_result r;
+            if (!run_isolated(w, threads, r))
+            {
+                cerr << w.name << ": run failed" << endl;
+                return 2;
+            }
+            if (!ok || r.seconds < best.seconds)
+                best = r;
+            ok = true;
+        }
+        cout << w.name << ": " << best.seconds << " s, " << best.throughput << " rows*iter/s, "
+             << best.peak_rss_kb << " KB, " << best.clusters << " clusters, accuracy "
+             << best.accuracy << ", converged at " << best.converged << endl;
+        results.push_back(best);
+    }
+
+    ofstream out(out_path);
+    out << to_json(results);
+    out.close();
+
+    if (baseline_path.empty())
+        return 0;
+    string text;
+    vector<bench_result> baseline;
+    if (!read_file(baseline_path, text) || !from_json(text, baseline))
+    {
+        cerr << "cannot read baseline " << baseline_path << endl;
+        return 2;
+    }
+    auto regressions = compare(baseline, results, tolerance, rss_tolerance, timing);
+    for (auto &r : regressions)
+        cout << "REGRESSION " << r.name << " " << r.metric << ": " << r.baseline << " -> " << r.current << endl;
+    return regressions.empty() ? 0 : 1;
+}
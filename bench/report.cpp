@@ -0,0 +1,221 @@
+//
+// Created by Jeff on 2019/2/2 0002.
+//
+
+#include "report.h"
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+/**
+ * 输出为JSON：{"workloads": [{...}, ...]}
+ */
+string to_json(const vector<bench_result> &results) {
+    ostringstream out;
+    out.precision(10);
+    out << "{\n  \"workloads\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"rows\": " << r.rows
+            << ", \"cols\": " << r.cols << ", \"iterations\": " << r.iterations
+            << ", \"converged\": " << r.converged
+            << ", \"clusters\": " << r.clusters << ", \"accuracy\": " << r.accuracy
+            << ", \"seconds\": " << r.seconds
+            << ", \"throughput\": " << r.throughput << ", \"peak_rss_kb\": " << r.peak_rss_kb
+            << ",\n     \"phases\": {";
+        bool first = true;
+        for (auto &p : r.phases) {
+            out << (first ? "" : ", ") << "\"" << p.first << "\": {\"calls\": " << p.second.calls
+                << ", \"wall_ms\": " << p.second.wall_ms << ", \"idle_ms\": " << p.second.idle_ms << "}";
+            first = false;
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+/**
+ * 只解析to_json输出格式所需的JSON子集：对象、数组、字符串(无转义)与数字
+ */
+class json_reader {
+public:
+    explicit json_reader(const string &s) : s(s), pos(0) {}
+    void skip()
+    {
+        while (pos < s.size() && isspace(static_cast<unsigned char>(s[pos])))
+            ++pos;
+    }
+    bool eat(char c)
+    {
+        skip();
+        if (pos < s.size() && s[pos] == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+    bool str(string &out)
+    {
+        if (!eat('"'))
+            return false;
+        auto end = s.find('"', pos);
+        if (end == string::npos)
+            return false;
+        out = s.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    }
+    bool num(double &out)
+    {
+        skip();
+        const char *b = s.c_str() + pos;
+        char *e;
+        out = strtod(b, &e);
+        if (e == b)
+            return false;
+        pos += static_cast<size_t>(e - b);
+        return true;
+    }
+    /**
+     * 遍历对象的各个键，f(key)负责读取对应的值
+     */
+    template <typename F>
+    bool object(F f)
+    {
+        if (!eat('{'))
+            return false;
+        if (eat('}'))
+            return true;
+        do {
+            string key;
+            if (!str(key) || !eat(':') || !f(key))
+                return false;
+        } while (eat(','));
+        return eat('}');
+    }
+
+private:
+    const string &s;
+    size_t pos;
+};
+
+bool from_json(const string &text, vector<bench_result> &results) {
+    json_reader in(text);
+    results.clear();
+    return in.object([&](const string &key) {
+        if (key != "workloads" || !in.eat('['))
+            return false;
+        if (in.eat(']'))
+            return true;
+        do {
+            bench_result r{};
+            bool ok = in.object([&](const string &field) {
+                double v(0);
+                if (field == "name")
+                    return in.str(r.name);
+                if (field == "phases")
+                {
+                    return in.object([&](const string &phase) {
+                        auto &p = r.phases[phase];
+                        return in.object([&](const string &f) {
+                            double x(0);
+                            if (!in.num(x))
+                                return false;
+                            if (f == "calls")
+                                p.calls = static_cast<unsigned long long>(x);
+                            else if (f == "wall_ms")
+                                p.wall_ms = x;
+                            else if (f == "idle_ms")
+                                p.idle_ms = x;
+                            return true;
+                        });
+                    });
+                }
+                if (!in.num(v))
+                    return false;
+                if (field == "rows")
+                    r.rows = static_cast<unsigned>(v);
+                else if (field == "cols")
+                    r.cols = static_cast<unsigned>(v);
+                else if (field == "iterations")
+                    r.iterations = static_cast<unsigned>(v);
+                else if (field == "converged")
+                    r.converged = static_cast<unsigned>(v);
+                else if (field == "clusters")
+                    r.clusters = static_cast<unsigned>(v);
+                else if (field == "accuracy")
+                    r.accuracy = v;
+                else if (field == "seconds")
+                    r.seconds = v;
+                else if (field == "throughput")
+                    r.throughput = v;
+                else if (field == "peak_rss_kb")
+                    r.peak_rss_kb = static_cast<long>(v);
+                return true;
+            });
+            if (!ok)
+                return false;
+            results.push_back(r);
+        } while (in.eat(','));
+        return in.eat(']');
+    });
+}
+
+/**
+ * 与基准比较，以下任一项即为退化：
+ * 收敛的迭代次数或最终的聚类个数与基准不同，准确率比基准低max_accuracy_drop以上，
+ * 峰值内存超过基准的(1+容差)倍；这几项与机器无关，可以和仓库中的基准比较。
+ * timing为true时另外比较耗时，只应与同一台机器上生成的基准比较：
+ * 耗时超过基准的(1+容差)倍，吞吐量低于基准的(1-容差)倍，
+ * 某个阶段的耗时超过基准的(1+容差)倍(只比较基准中占总耗时至少min_phase_share的阶段，过短的阶段噪声太大)；
+ * 耗时与吞吐量的差另外至少要超过slack_ms毫秒，毫秒级的短负载只有计时噪声
+ * 样本数或特征数与基准不同(--scale不同)时结果不可比，记为一项"rows"退化；基准中没有的负载不比较
+ */
+vector<regression> compare(const vector<bench_result> &baseline, const vector<bench_result> &current,
+                           double time_tolerance, double rss_tolerance, bool timing) {
+    const double min_phase_share = 0.05;
+    const double max_accuracy_drop = 0.01;
+    const double slack_ms = 2;
+    vector<regression> res;
+    for (auto &cur : current) {
+        for (auto &base : baseline) {
+            if (base.name != cur.name)
+                continue;
+            if (base.rows != cur.rows || base.cols != cur.cols)
+            {
+                res.push_back(regression{cur.name, "rows", static_cast<double>(base.rows), static_cast<double>(cur.rows)});
+                continue;
+            }
+            if (cur.converged != base.converged)
+                res.push_back(regression{cur.name, "converged", static_cast<double>(base.converged),
+                                         static_cast<double>(cur.converged)});
+            if (cur.clusters != base.clusters)
+                res.push_back(regression{cur.name, "clusters", static_cast<double>(base.clusters),
+                                         static_cast<double>(cur.clusters)});
+            if (cur.accuracy < base.accuracy - max_accuracy_drop)
+                res.push_back(regression{cur.name, "accuracy", base.accuracy, cur.accuracy});
+            if (cur.peak_rss_kb > base.peak_rss_kb * (1 + rss_tolerance))
+                res.push_back(regression{cur.name, "peak_rss_kb", static_cast<double>(base.peak_rss_kb),
+                                         static_cast<double>(cur.peak_rss_kb)});
+            if (!timing)
+                continue;
+            const bool slower = (cur.seconds - base.seconds) * 1000 > slack_ms;
+            if (slower && cur.seconds > base.seconds * (1 + time_tolerance))
+                res.push_back(regression{cur.name, "seconds", base.seconds, cur.seconds});
+            if (slower && cur.throughput < base.throughput * (1 - time_tolerance))
+                res.push_back(regression{cur.name, "throughput", base.throughput, cur.throughput});
+            for (auto &p : base.phases) {
+                auto it = cur.phases.find(p.first);
+                if (it == cur.phases.end() || p.second.wall_ms < base.seconds * 1000 * min_phase_share)
+                    continue;
+                if (it->second.wall_ms > p.second.wall_ms * (1 + time_tolerance) &&
+                    it->second.wall_ms - p.second.wall_ms > slack_ms)
+                    res.push_back(regression{cur.name, "phase " + p.first + " wall_ms", p.second.wall_ms,
+                                             it->second.wall_ms});
+            }
+        }
+    }
+    return res;
+}
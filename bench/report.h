@@ -0,0 +1,57 @@
+//
+// Created by Jeff on 2019/2/2 0002.
+//
+
+#ifndef ISODATA_REPORT_H
+#define ISODATA_REPORT_H
+
+#include <vector>
+#include <string>
+#include <map>
+
+using namespace std;
+
+/**
+ * 一个阶段的耗时，毫秒
+ */
+struct phase_result {
+    unsigned long long calls;
+    double wall_ms;
+    double idle_ms;
+};
+
+/**
+ * 一个负载的测试结果
+ */
+struct bench_result {
+    string name;
+    unsigned rows;
+    unsigned cols;
+    unsigned iterations;
+    unsigned converged; // 最后一次有样本改变所属聚类的迭代
+    unsigned clusters; // 最终的聚类个数
+    double accuracy; // 与生成数据时类别的一致程度，见workload.h的accuracy
+    double seconds; // run()的耗时
+    double throughput; // 每秒处理的 样本数*迭代次数
+    long peak_rss_kb; // 进程的峰值常驻内存
+    map<string, phase_result> phases;
+};
+
+string to_json(const vector<bench_result> &results);
+bool from_json(const string &text, vector<bench_result> &results);
+
+/**
+ * 与基准比较的一项
+ */
+struct regression {
+    string name;
+    string metric;
+    double baseline;
+    double current;
+};
+
+vector<regression> compare(const vector<bench_result> &baseline, const vector<bench_result> &current,
+                           double time_tolerance, double rss_tolerance, bool timing);
+
+
+#endif //ISODATA_REPORT_H
@@ -0,0 +1,198 @@
+//
+// Created by Jeff on 2019/2/2 0002.
+//
+
+#include "workload.h"
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * 默认的一组负载
+ * @param scale 样本个数的缩放系数
+ */
+vector<workload> default_workloads(double scale) {
+    auto n = [scale](unsigned rows) { return max(static_cast<unsigned>(rows * scale), 100u); };
+    vector<workload> res;
+    res.push_back(workload{"blobs", WL_BLOBS, n(100000), 16, 8, 3, 0, 1, 20, false, false, false});
+    res.push_back(workload{"skewed", WL_SKEWED, n(100000), 8, 8, 3, 0, 2, 20, false, false, false});
+    res.push_back(workload{"duplicates", WL_DUPLICATES, n(50000), 2, 6, 10, 0, 3, 20, false, false, false});
+    // 初始中心取到同一类的两个样本时，这两个聚类很快合并，丢掉的类不会再分裂出来：
+    // 稀疏数据每列只在少数样本上非零，两类混在一起时各列的标准差与单独一类相差无几。
+    // 每个剩下的聚类基本只含一类，accuracy约为 聚类个数/k，这个种子下为7/10
+    res.push_back(workload{"sparse", WL_SPARSE, n(20000), 2000, 10, 1, 0.01, 4, 20, false, false, false});
+    // 同一份数据分别用NUMA分配与可复现模式运行，比较可复现模式的开销
+    res.push_back(workload{"blobs_numa", WL_BLOBS, n(100000), 16, 8, 3, 0, 1, 20, true, false, false});
+    res.push_back(workload{"blobs_numa_det", WL_BLOBS, n(100000), 16, 8, 3, 0, 1, 20, true, true, false});
+    // 同一份数据分别用欧式距离与对角马氏距离运行，比较收敛所需的迭代次数与总耗时
+    res.push_back(workload{"aniso", WL_ANISOTROPIC, n(100000), 16, 8, 3, 0, 5, 20, false, false, false});
+    res.push_back(workload{"aniso_diag", WL_ANISOTROPIC, n(100000), 16, 8, 3, 0, 5, 20, false, false, true});
+    res.push_back(workload{"blobs_diag", WL_BLOBS, n(100000), 16, 8, 3, 0, 1, 20, false, false, true});
+    // 两个平行的细长团，初始中心落在同一侧时欧式距离把它们横向切开；比较两种度量的accuracy
+    // (结果依赖初始中心，这个种子下两者不同，其他种子下可能相同)
+    res.push_back(workload{"parallel", WL_PARALLEL, n(20000), 2, 2, 1, 0, 4, 20, false, false, false});
+    res.push_back(workload{"parallel_diag", WL_PARALLEL, n(20000), 2, 2, 1, 0, 4, 20, false, false, true});
+    return res;
+}
+
+/**
+ * 各类的中心，类之间相距约8倍类内标准差
+ */
+static vector<vector<double>> make_centers(const workload &w, std::mt19937 &rand)
+{
+    std::uniform_real_distribution<double> u(0, 8 * w.spread * cbrt(static_cast<double>(w.k)));
+    vector<vector<double>> centers(w.k, vector<double>(w.cols));
+    for (auto &c : centers)
+        for (auto &v : c)
+            v = u(rand);
+    return centers;
+}
+
+/**
+ * 生成稠密数据
+ * 随机数引擎使用mt19937，同一标准库下同一种子生成的数据相同
+ * @param truth 不为空时输出每个样本生成时所属的类别
+ */
+vector<vector<double>> generate_dense(const workload &w, vector<unsigned> *truth) {
+    std::mt19937 rand(w.seed);
+    auto centers = make_centers(w, rand);
+    std::normal_distribution<double> noise(0, w.spread);
+    if (truth)
+        truth->clear();
+    if (w.kind == WL_PARALLEL)
+    {
+        vector<vector<double>> res;
+        res.reserve(w.rows);
+        for (unsigned r = 0; r < w.rows; ++r) {
+            auto j = r % 2;
+            vector<double> p(w.cols, 0);
+            for (unsigned i = 0; i < w.cols; ++i)
+                p[i] = (i == 0 ? 10 * w.spread * j : 0) + (i == 1 ? 8 : 1) * noise(rand);
+            res.push_back(p);
+            if (truth)
+                truth->push_back(j);
+        }
+        return res;
+    }
+    // 各类的样本比例
+    vector<double> share(w.k, 1.0);
+    if (w.kind == WL_SKEWED)
+    {
+        for (unsigned j = 0; j < w.k; ++j)
+            share[j] = 1 / pow(j + 1.0, 1.5);
+    }
+    std::discrete_distribution<unsigned> pick(share.begin(), share.end());
+    // 各类各维标准差的倍数，在[1/4, 4]内按对数均匀分布
+    vector<vector<double>> stretch(w.k, vector<double>(w.cols, 1.0));
+    if (w.kind == WL_ANISOTROPIC)
+    {
+        std::uniform_real_distribution<double> e(-2, 2);
+        for (auto &s : stretch)
+            for (auto &v : s)
+                v = exp2(e(rand));
+    }
+    vector<vector<double>> res;
+    res.reserve(w.rows);
+    if (w.kind == WL_DUPLICATES)
+    {
+        // 每类只有几十个不同的样本，其余都是它们的重复
+        vector<vector<double>> distinct;
+        for (unsigned i = 0; i < w.k * 40; ++i) {
+            auto p = centers[i % w.k];
+            for (auto &v : p)
+                v = round(v + noise(rand));
+            distinct.push_back(p);
+        }
+        std::uniform_int_distribution<size_t> any(0, distinct.size() - 1);
+        for (unsigned r = 0; r < w.rows; ++r) {
+            auto d = any(rand);
+            res.push_back(distinct[d]);
+            if (truth)
+                truth->push_back(static_cast<unsigned>(d % w.k));
+        }
+        return res;
+    }
+    for (unsigned r = 0; r < w.rows; ++r) {
+        auto j = pick(rand);
+        auto p = centers[j];
+        for (unsigned i = 0; i < w.cols; ++i)
+            p[i] += stretch[j][i] * noise(rand);
+        res.push_back(p);
+        if (truth)
+            truth->push_back(j);
+    }
+    return res;
+}
+
+/**
+ * 生成稀疏数据，每类有自己的一组常用列，样本的非零元大多落在所属类的常用列上
+ */
+csr_matrix generate_sparse(const workload &w, vector<unsigned> *truth) {
+    std::mt19937 rand(w.seed);
+    if (truth)
+        truth->clear();
+    const auto nnz = max(static_cast<unsigned>(w.cols * w.density), 1u);
+    const unsigned topic = max(w.cols / w.k, nnz);
+    std::uniform_int_distribution<unsigned> cls(0, w.k - 1);
+    std::uniform_int_distribution<unsigned> in_topic(0, topic - 1);
+    std::uniform_int_distribution<unsigned> any(0, w.cols - 1);
+    std::uniform_real_distribution<double> coin(0, 1);
+    std::uniform_real_distribution<double> value(0.5, 1.5);
+    csr_matrix m;
+    m.rows = w.rows;
+    m.cols = w.cols;
+    vector<pair<unsigned, double>> line;
+    for (unsigned r = 0; r < w.rows; ++r) {
+        auto j = cls(rand);
+        if (truth)
+            truth->push_back(j);
+        line.clear();
+        for (unsigned t = 0; t < nnz; ++t) {
+            auto c = coin(rand) < 0.8 ? (j * topic + in_topic(rand)) % w.cols : any(rand);
+            line.emplace_back(c, value(rand) * w.spread);
+        }
+        sort(line.begin(), line.end());
+        line.erase(unique(line.begin(), line.end(), [](const pair<unsigned, double> &a, const pair<unsigned, double> &b) {
+            return a.first == b.first;
+        }), line.end());
+        double sq(0);
+        for (auto &e : line) {
+            m.indices.push_back(e.first);
+            m.values.push_back(e.second);
+            sq += e.second * e.second;
+        }
+        m.indptr.push_back(m.values.size());
+        m.sqnorm.push_back(sq);
+    }
+    return m;
+}
+
+/**
+ * 稀疏数据两个类中心之间的期望距离
+ * 每行nnz个非零元中约80%落在所属类的topic个常用列上，值的期望为spread，
+ * 类中心在每个常用列上约为0.8*nnz/topic*spread，两类的常用列互不重叠
+ */
+double center_gap(const workload &w) {
+    const auto nnz = max(static_cast<unsigned>(w.cols * w.density), 1u);
+    const unsigned topic = max(w.cols / w.k, nnz);
+    return 0.8 * nnz / topic * w.spread * sqrt(2.0 * topic);
+}
+
+/**
+ * 聚类结果与生成时类别的一致程度：每个聚类按其中最多的真实类别计，
+ * 返回计对的样本比例；不属于任何聚类(编号为0)的样本计错
+ * @param labels isodata::labels()，从1开始
+ */
+double accuracy(const vector<int32_t> &labels, const vector<unsigned> &truth) {
+    if (labels.empty() || labels.size() != truth.size())
+        return 0;
+    const auto k = static_cast<size_t>(*max_element(labels.begin(), labels.end())) + 1;
+    const auto t = static_cast<size_t>(*max_element(truth.begin(), truth.end())) + 1;
+    vector<size_t> counts(k * t, 0);
+    for (size_t i = 0; i < labels.size(); ++i)
+        ++counts[static_cast<size_t>(max(labels[i], 0)) * t + truth[i]];
+    size_t right(0);
+    for (size_t j = 1; j < k; ++j)
+        right += *max_element(counts.begin() + j * t, counts.begin() + (j + 1) * t);
+    return static_cast<double>(right) / labels.size();
+}
@@ -0,0 +1,51 @@
+//
+// Created by Jeff on 2019/2/2 0002.
+//
+
+#ifndef ISODATA_WORKLOAD_H
+#define ISODATA_WORKLOAD_H
+
+#include <vector>
+#include <string>
+#include "../sparse.h"
+
+using namespace std;
+
+/**
+ * 合成数据的种类
+ */
+enum workload_kind {
+    WL_BLOBS, // 大小相同的高斯团
+    WL_SKEWED, // 大小按幂律分布的高斯团
+    WL_DUPLICATES, // 少量不同的样本大量重复，类似data.txt
+    WL_SPARSE, // 高维稀疏数据，每个类集中在一部分列上
+    WL_ANISOTROPIC, // 各维标准差不同的高斯团，每类沿不同的维度拉长
+    WL_PARALLEL, // 两个平行的细长高斯团，沿第二维拉长8倍，第一维相距10倍标准差
+};
+
+/**
+ * 一个基准测试负载：数据的生成方式与isodata的参数
+ */
+struct workload {
+    string name;
+    workload_kind kind;
+    unsigned rows; // 样本个数
+    unsigned cols; // 特征个数
+    unsigned k; // 生成数据时的类别数
+    double spread; // 类内标准差
+    double density; // 稀疏数据每行非零元的比例
+    unsigned seed; // 生成数据与isodata共用的种子
+    unsigned iterations; // isodata的最多迭代次数
+    bool numa; // 是否使用NUMA分配
+    bool deterministic; // 是否使用可复现模式
+    bool diagonal; // 是否使用对角马氏距离分配
+};
+
+vector<workload> default_workloads(double scale);
+vector<vector<double>> generate_dense(const workload &w, vector<unsigned> *truth = nullptr);
+csr_matrix generate_sparse(const workload &w, vector<unsigned> *truth = nullptr);
+double center_gap(const workload &w);
+double accuracy(const vector<int32_t> &labels, const vector<unsigned> &truth);
+
+
+#endif //ISODATA_WORKLOAD_H
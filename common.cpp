@@ -6,6 +6,26 @@
 #include <sstream>
 #include <fstream>
 
+const string DATA_PATH = R"(E:\CPP\Clion\ISODATA\data.txt)";
+
+/**
+ * 解析一行样本，特征之间用'，'间隔
+ */
+static vector<double> parse_line(const string &s)
+{
+    stringstream ss(s);
+    vector<double> line;
+    double d;
+    char c;
+    while (!ss.eof() && ss >> d)
+    {
+        line.emplace_back(d);
+        ss >> c;
+
+    }
+    return line;
+}
+
 /**
  * 读取数据
  * 数据存放在txt文件中，一个样本占用一行，
@@ -14,28 +34,17 @@
  */
 vector<vector<double>> read_data()
 {
-    const string path = R"(E:\CPP\Clion\ISODATA\data.txt)";
-    ifstream f(path);
+    ifstream f(DATA_PATH);
     if (!f.is_open())
     {
         cout << WARN_FILE_OPEN_FAIL << endl;
     }
     vector<vector<double>> data;
-    int id(0);
     while (!f.eof())
     {
         string s;
         getline(f, s);
-        stringstream ss(s);
-        vector<double> line;
-        double d;
-        char c;
-        while (!ss.eof() && ss >> d)
-        {
-            line.emplace_back(d);
-            ss >> c;
-
-        }
+        auto &&line = parse_line(s);
         if (!line.empty())
             data.emplace_back(line);
     }
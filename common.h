@@ -8,6 +8,7 @@
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "error.h"
 
 using namespace std;
@@ -15,7 +16,7 @@ using namespace std;
 vector<vector<double>> read_data();
 
 template <typename T>
-double get_distance(vector<T> &p1, vector<T> &p2);
+double get_distance(const vector<T> &p1, const vector<T> &p2);
 template <typename T>
 vector<T> operator+(vector<T> &left, vector<T>& right);
 template <typename T>
@@ -42,6 +43,13 @@ template <typename T>
 vector<double> operator*(vector<double> &left, T d);
 template <typename T>
 ostream& operator<<(ostream& out, vector<T>& tvec);
+// 以下为原地运算，结果写回第一个参数，不产生临时矢量
+template <typename V1, typename V2>
+void add_scaled(V1 &acc, const V2 &right, double r);
+template <typename V>
+void scale_inplace(V &left, double r);
+template <typename V>
+void sqrt_inplace(V &left);
 
 
 
@@ -52,7 +60,7 @@ ostream& operator<<(ostream& out, vector<T>& tvec);
  * @return
  */
 template <typename T>
-double get_distance(vector<T> &p1, vector<T> &p2)
+double get_distance(const vector<T> &p1, const vector<T> &p2)
 {
     if (p1.size() != p2.size())
     {
@@ -268,6 +276,48 @@ vector<T> operator+(vector<T> left, vector<T> right) {
     return res;
 }
 
+/**
+ * 矢量按比例累加 acc += right * r
+ * @param acc
+ * @param right
+ * @param r
+ */
+template <typename V1, typename V2>
+void add_scaled(V1 &acc, const V2 &right, double r)
+{
+    if (acc.size() != right.size())
+        cout << WARN_VECTOR_SIZE << endl;
+    auto len(min(acc.size(), right.size()));
+    for (size_t i = 0; i < len; ++i) {
+        acc[i] += right[i] * r;
+    }
+}
+
+/**
+ * 矢量原地乘标量
+ * @param left
+ * @param r
+ */
+template <typename V>
+void scale_inplace(V &left, double r)
+{
+    for (auto &item : left) {
+        item *= r;
+    }
+}
+
+/**
+ * 矢量原地开平方
+ * @param left
+ */
+template <typename V>
+void sqrt_inplace(V &left)
+{
+    for (auto &item : left) {
+        item = sqrt(item);
+    }
+}
+
 /**
  * 矢量输出
  * @tparam T
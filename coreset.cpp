@@ -0,0 +1,58 @@
+//
+// Created by Jeff on 2019/1/24 0024.
+//
+
+#include "coreset.h"
+#include "common.h"
+#include <random>
+#include <map>
+
+/**
+ * 构造轻量级coreset
+ * @param data 全部样本
+ * @param m 抽样次数，重复抽中的样本会合并，因此返回的样本数不超过m
+ * @param seed 随机种子
+ * @param weights 输出，每个被选中样本的权重，权重之和的期望为样本总数
+ * @return 被选中样本在data中的id，按id升序
+ */
+vector<unsigned> lightweight_coreset(const vector<vector<double>> &data, size_t m,
+                                     unsigned seed, vector<double> &weights)
+{
+    weights.clear();
+    const size_t n = data.size();
+    if (n == 0 || m == 0)
+        return {};
+    const size_t col = data[0].size();
+    // 全部样本的均值
+    vector<double> mu(col, 0);
+    for (auto &p : data)
+        add_scaled(mu, p, 1);
+    scale_inplace(mu, 1 / static_cast<double>(n));
+    // 到均值的距离平方
+    vector<double> q(n);
+    double total(0);
+    for (size_t i = 0; i < n; ++i) {
+        double d(0);
+        for (size_t j = 0; j < col; ++j)
+            d += (data[i][j] - mu[j]) * (data[i][j] - mu[j]);
+        q[i] = d;
+        total += d;
+    }
+    for (auto &v : q)
+        v = 0.5 / n + (total > 0 ? 0.5 * v / total : 0.5 / n);
+    std::default_random_engine rand(seed);
+    std::discrete_distribution<size_t> pick(q.begin(), q.end());
+    map<unsigned, double> chosen;
+    for (size_t k = 0; k < m; ++k) {
+        auto id = pick(rand);
+        chosen[static_cast<unsigned>(id)] += 1 / (static_cast<double>(m) * q[id]);
+    }
+    vector<unsigned> ids;
+    ids.reserve(chosen.size());
+    weights.reserve(chosen.size());
+    for (auto &item : chosen) {
+        ids.push_back(item.first);
+        weights.push_back(item.second);
+    }
+    return ids;
+}
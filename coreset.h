@@ -0,0 +1,21 @@
+//
+// Created by Jeff on 2019/1/24 0024.
+//
+
+#ifndef ISODATA_CORESET_H
+#define ISODATA_CORESET_H
+
+#include <vector>
+
+using namespace std;
+
+// 轻量级coreset(Bachem et al. 2018)
+// 按 q(x) = 1/2 * 1/n + 1/2 * d(x, mu)^2 / sum(d^2) 的概率有放回地抽取m次，
+// 每个样本的权重为 1 / (m * q(x))，被重复抽中的样本合并权重。
+// 对任意一组聚类中心，加权后的量化误差与全部数据的量化误差之差有上界，
+// 上界随m增大按 1/sqrt(m) 减小
+vector<unsigned> lightweight_coreset(const vector<vector<double>> &data, size_t m,
+                                     unsigned seed, vector<double> &weights);
+
+
+#endif //ISODATA_CORESET_H
@@ -0,0 +1,522 @@
+//
+// Created by Jeff on 2019/1/20 0020.
+//
+
+#include "distributed.h"
+#include "shard.h"
+#include "common.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <random>
+#include <algorithm>
+#include <ctime>
+
+dist_isodata::~dist_isodata() {
+    stop_workers();
+}
+
+/**
+ * 创建分片进程，每个进程通过一对Unix套接字与协调进程通信
+ * 分片进程自己调用shard_func读取数据，协调进程不持有样本
+ * @return 是否全部启动成功
+ */
+bool dist_isodata::start_workers() {
+    for (unsigned i = 0; i < _nw; ++i) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        {
+            cout << WARN_IPC_FAIL << endl;
+            ok = false;
+            return false;
+        }
+        auto pid = fork();
+        if (pid < 0)
+        {
+            cout << WARN_IPC_FAIL << endl;
+            close(fds[0]);
+            close(fds[1]);
+            ok = false;
+            return false;
+        }
+        if (pid == 0)
+        {
+            // 分片进程：关闭继承来的其他套接字
+            close(fds[0]);
+            for (auto &w : workers)
+                close(w.fd);
+            shard_worker sw(fds[1], shard_func(i, _nw));
+            sw.serve();
+            close(fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        workers.push_back(worker{pid, fds[0]});
+    }
+    // 等待每个分片报告自己的规模
+    row = 0;
+    for (auto &w : workers) {
+        uint32_t type;
+        msg_buffer in;
+        if (!recv_msg(w.fd, type, in) || type != MSG_HELLO)
+        {
+            cout << WARN_IPC_FAIL << endl;
+            ok = false;
+            return false;
+        }
+        auto r = in.get<uint32_t>();
+        auto c = in.get<uint32_t>();
+        if (!in.good() || in.left() != 0)
+        {
+            cout << WARN_IPC_FAIL << endl;
+            ok = false;
+            return false;
+        }
+        if (r > 0 && col != 0 && c != col)
+        {
+            cout << WARN_DATA_SIZE << endl;
+            ok = false;
+            return false;
+        }
+        if (r > 0)
+            col = c;
+        row += r;
+    }
+    if (row < _c || row < _tn || row < _nc)
+    {
+        cout << WARN_DATA_SIZE << endl;
+        ok = false;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 通知分片进程退出并回收
+ */
+void dist_isodata::stop_workers() {
+    for (auto &w : workers) {
+        send_msg(w.fd, MSG_QUIT, msg_buffer());
+        close(w.fd);
+        waitpid(w.pid, nullptr, 0);
+    }
+    workers.clear();
+}
+
+/**
+ * 向每个分片发送各自的负载，再依次接收应答
+ * 先全部发送再接收，各分片的计算可以并行进行
+ */
+bool dist_isodata::request(uint32_t type, const vector<msg_buffer> &payloads, vector<msg_buffer> &replies) {
+    if (!ok)
+        return false;
+    replies.resize(workers.size());
+    for (unsigned i = 0; i < workers.size(); ++i) {
+        if (!send_msg(workers[i].fd, type, payloads[i]))
+            ok = false;
+    }
+    for (unsigned i = 0; i < workers.size() && ok; ++i) {
+        uint32_t t;
+        if (!recv_msg(workers[i].fd, t, replies[i]) || t != MSG_REPLY)
+            ok = false;
+    }
+    if (!ok)
+        cout << WARN_IPC_FAIL << endl;
+    return ok;
+}
+
+bool dist_isodata::broadcast(uint32_t type, const msg_buffer &payload, vector<msg_buffer> &replies) {
+    return request(type, vector<msg_buffer>(workers.size(), payload), replies);
+}
+
+/**
+ * 应答是否恰好读完，长度不符(越界或有剩余)时按通信失败处理
+ */
+bool dist_isodata::consumed(const vector<msg_buffer> &replies) {
+    for (auto &in : replies) {
+        if (!in.good() || in.left() != 0)
+        {
+            if (ok)
+                cout << WARN_IPC_FAIL << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * 写入聚类个数与全部聚类中心
+ */
+void dist_isodata::put_centers(msg_buffer &out) const {
+    out.put<uint32_t>(static_cast<uint32_t>(clusters.size()));
+    for (auto &cluster : clusters)
+        out.put(cluster.center.data(), col);
+}
+
+/**
+ * 按分片顺序归约应答中的统计量，覆盖指定聚类原有的统计量
+ * @param which 应答中统计量对应的聚类序号
+ */
+void dist_isodata::read_stats(vector<msg_buffer> &replies, const vector<unsigned> &which) {
+    for (auto c : which) {
+        clusters[c].n = 0;
+        fill(clusters[c].sum.begin(), clusters[c].sum.end(), 0);
+        fill(clusters[c].sumsq.begin(), clusters[c].sumsq.end(), 0);
+    }
+    vector<double> buf(1 + 2 * static_cast<size_t>(col));
+    for (auto &in : replies) {
+        for (auto c : which) {
+            auto &cluster = clusters[c];
+            in.get(buf.data(), buf.size());
+            cluster.n += buf[0];
+            for (unsigned i = 0; i < col; ++i) {
+                cluster.sum[i] += buf[1 + i];
+                cluster.sumsq[i] += buf[1 + col + i];
+            }
+        }
+    }
+    consumed(replies);
+}
+
+/**
+ * 通知分片按映射修改样本的聚类编号
+ */
+void dist_isodata::relabel(const vector<int32_t> &mapping, unsigned newk) {
+    msg_buffer out;
+    out.put<uint32_t>(static_cast<uint32_t>(mapping.size()));
+    out.put<uint32_t>(newk);
+    out.put(mapping.data(), mapping.size());
+    vector<msg_buffer> replies;
+    if (broadcast(MSG_RELABEL, out, replies))
+        consumed(replies);
+}
+
+/**
+ * 初始化 从各分片收集随机样本，再从中选取_nc个互不重复的聚类中心
+ */
+void dist_isodata::init_clusters() {
+    std::default_random_engine rand(fixed_seed ? seed : static_cast<unsigned int>(time(nullptr)));
+    vector<msg_buffer> payloads(workers.size());
+    for (auto &p : payloads) {
+        p.put<uint32_t>(_nc);
+        p.put<uint32_t>(static_cast<uint32_t>(rand()));
+    }
+    vector<msg_buffer> replies;
+    if (!request(MSG_SEED, payloads, replies))
+        return;
+    vector<vector<double>> pool;
+    for (auto &in : replies) {
+        auto m = in.get<uint32_t>();
+        for (unsigned i = 0; i < m && in.good(); ++i) {
+            vector<double> p(col);
+            in.get(p.data(), col);
+            pool.emplace_back(std::move(p));
+        }
+    }
+    if (!consumed(replies))
+        return;
+    shuffle(pool.begin(), pool.end(), rand);
+    for (auto &p : pool) {
+        if (clusters.size() >= _nc)
+            break;
+        // 避免数据之间有重复的 选取出重复的中心点坐标
+        bool flg = false;
+        for (auto &cluster : clusters) {
+            if (get_distance(cluster.center, p) == 0.0)
+                flg = true;
+        }
+        if (!flg)
+            clusters.emplace_back(p);
+    }
+}
+
+/**
+ * 下发聚类中心，各分片依据距离最小原则重新分配，并返回统计量
+ */
+void dist_isodata::re_assign() {
+    msg_buffer out;
+    put_centers(out);
+    vector<msg_buffer> replies;
+    if (!broadcast(MSG_ASSIGN, out, replies))
+        return;
+    vector<unsigned> all(clusters.size());
+    for (unsigned i = 0; i < all.size(); ++i)
+        all[i] = i;
+    read_stats(replies, all);
+}
+
+/**
+ * 检测每个聚类中的个数是否少于_tn，如果少于则取消此类别
+ * 与isodata::check_tn相同，按聚类顺序逐个处理，被取消聚类的样本分配到未被取消的最近聚类
+ */
+void dist_isodata::check_tn() {
+    vector<uint32_t> to_erase;
+    bool moved = false;
+    for (unsigned i = 0; i < clusters.size() && ok; ++i) {
+        if (clusters[i].n >= _tn)
+            continue;
+        to_erase.push_back(i);
+        if (to_erase.size() == clusters.size())
+            break;
+        msg_buffer out;
+        out.put<uint32_t>(i);
+        out.put<uint32_t>(static_cast<uint32_t>(to_erase.size()));
+        out.put(to_erase.data(), to_erase.size());
+        vector<msg_buffer> replies;
+        if (!broadcast(MSG_MOVE, out, replies))
+            return;
+        for (auto &cluster : clusters)
+            cluster.n = 0;
+        vector<double> counts(clusters.size());
+        for (auto &in : replies) {
+            in.get(counts.data(), counts.size());
+            for (unsigned j = 0; j < clusters.size(); ++j)
+                clusters[j].n += counts[j];
+        }
+        if (!consumed(replies))
+            return;
+        moved = true;
+    }
+    if (!moved)
+        return;
+    // 删除空的聚类，重新编号
+    vector<int32_t> mapping(clusters.size(), -1);
+    deque<dist_cluster> kept;
+    for (unsigned i = 0; i < clusters.size(); ++i) {
+        if (clusters[i].n > 0)
+        {
+            mapping[i] = static_cast<int32_t>(kept.size());
+            kept.emplace_back(std::move(clusters[i]));
+        }
+    }
+    swap(kept, clusters);
+    relabel(mapping, static_cast<unsigned>(clusters.size()));
+    vector<msg_buffer> replies;
+    if (!broadcast(MSG_STATS, msg_buffer(), replies))
+        return;
+    vector<unsigned> all(clusters.size());
+    for (unsigned i = 0; i < all.size(); ++i)
+        all[i] = i;
+    read_stats(replies, all);
+}
+
+/**
+ * 用统计量更新各个聚类的中心坐标
+ */
+void dist_isodata::update_centers() {
+    for (auto &cluster : clusters) {
+        if (cluster.n > 0)
+            cluster.center = cluster.sum / cluster.n;
+    }
+}
+
+/**
+ * 用统计量更新单个聚类的标准差
+ * sum((c-x)^2) = sumsq - 2*c*sum + n*c^2
+ */
+void dist_isodata::update_sigma(dist_cluster &cluster) {
+    cluster.sigma.resize(col);
+    for (unsigned i = 0; i < col; ++i) {
+        auto c = cluster.center[i];
+        auto s = cluster.sumsq[i] - 2 * c * cluster.sum[i] + cluster.n * c * c;
+        cluster.sigma[i] = sqrt(max(s, 0.0));
+    }
+}
+
+/**
+ * 更新平均距离，距离和由各分片计算
+ */
+void dist_isodata::update_meandis() {
+    msg_buffer out;
+    put_centers(out);
+    vector<msg_buffer> replies;
+    if (!broadcast(MSG_MEANDIS, out, replies))
+        return;
+    vector<double> dis(clusters.size(), 0), part(clusters.size());
+    for (auto &in : replies) {
+        in.get(part.data(), part.size());
+        for (unsigned i = 0; i < dis.size(); ++i)
+            dis[i] += part[i];
+    }
+    if (!consumed(replies))
+        return;
+    allMeanDis = 0;
+    for (unsigned i = 0; i < clusters.size(); ++i) {
+        allMeanDis += dis[i];
+        clusters[i].innerMeanDis = dis[i] / clusters[i].n;
+    }
+    allMeanDis /= row;
+}
+
+/**
+ * 检测是否需要分裂，如果需要则执行分裂操作，规则与isodata::check_split相同
+ * 分裂失败(新聚类没有分到样本)的聚类状态不变，不再重试，否则会反复分裂同一个聚类
+ */
+void dist_isodata::check_split() {
+    for (auto &cluster : clusters)
+        update_sigma(cluster);
+    vector<char> failed(clusters.size(), 0);
+    while (ok)
+    {
+        bool flag = false;
+        for (unsigned j = 0; j < clusters.size() && ok; ++j) {
+            for (int i = 0; i < col && !failed[j]; ++i) {
+                auto &cluster = clusters[j];
+                bool want;
+                if (cluster.innerMeanDis > allMeanDis)
+                    want = cluster.sigma[i] > _te && (cluster.n > 2 * _tn + 1 || clusters.size() < _c / 2);
+                else
+                    want = cluster.sigma[i] > _te && clusters.size() < _c / 2;
+                if (!want)
+                    continue;
+                if (split(j))
+                {
+                    flag = true;
+                    failed.push_back(0);
+                } else
+                    failed[j] = 1;
+            }
+        }
+        if (!flag)
+            break;
+        else
+            update_meandis();
+    }
+}
+
+/**
+ * 分裂第c_index个聚类，样本的重新划分由各分片完成
+ * @param c_index
+ * @return 是否保留了新聚类，新聚类没有分到样本时返回false
+ */
+bool dist_isodata::split(const int &c_index) {
+    auto pos = distance(clusters[c_index].sigma.begin(),
+                        max_element(clusters[c_index].sigma.begin(), clusters[c_index].sigma.end()));
+    clusters.emplace_back(clusters[c_index].center);
+    auto &cluster = clusters[c_index];
+    auto &newcluster = clusters.back();
+    auto dst = static_cast<unsigned>(clusters.size() - 1);
+    newcluster.center[pos] -= alpha*cluster.center[pos];
+    cluster.center[pos] += alpha*cluster.center[pos];
+    msg_buffer out;
+    out.put<uint32_t>(static_cast<uint32_t>(c_index));
+    out.put<uint32_t>(dst);
+    out.put(cluster.center.data(), col);
+    out.put(newcluster.center.data(), col);
+    vector<msg_buffer> replies;
+    if (!broadcast(MSG_SPLIT, out, replies))
+        return false;
+    read_stats(replies, {static_cast<unsigned>(c_index), dst});
+    if (!ok)
+        return false;
+    // 更新参数，没有分到样本的新聚类直接丢弃
+    for (auto c : {static_cast<unsigned>(c_index), dst}) {
+        if (clusters[c].n > 0)
+        {
+            clusters[c].center = clusters[c].sum / clusters[c].n;
+            update_sigma(clusters[c]);
+        }
+    }
+    if (clusters.back().n == 0)
+    {
+        clusters.pop_back();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 检测是否需要合并，如果需要则执行合并操作，规则与isodata::check_merge相同
+ * 被合并聚类的样本归入合并后的聚类
+ */
+void dist_isodata::check_merge() {
+    typedef pair<pair<unsigned, unsigned>, double> UNIT;
+    vector<UNIT> uvec;
+    for (unsigned i = 0; i < clusters.size(); ++i) {
+        for (unsigned j = i+1; j < clusters.size(); ++j) {
+            auto dis = get_distance(clusters[i].center, clusters[j].center);
+            if (dis < _tc)
+                uvec.emplace_back(UNIT({i,j}, dis));
+        }
+    }
+    sort(uvec.begin(), uvec.end(), [](UNIT& left, UNIT& right){ return left.second < right.second;});
+    vector<char> used(clusters.size(), 0);
+    vector<int> into(clusters.size(), -1);
+    // 每次迭代最多合并_nt次
+    unsigned cnt(0);
+    for (const auto &unit : uvec) {
+        if (cnt >= _nt)
+            break;
+        auto& cids = unit.first;
+        if (!used[cids.first] && !used[cids.second])
+        {
+            merge(cids.first, cids.second);
+            into[cids.second] = cids.first;
+            used[cids.first] = used[cids.second] = 1;
+            ++cnt;
+        }
+    }
+    if (count(used.begin(), used.end(), 1) == 0)
+        return;
+    vector<int32_t> mapping(clusters.size(), -1);
+    deque<dist_cluster> kept;
+    for (unsigned i = 0; i < clusters.size(); ++i) {
+        if (clusters[i].n > 0)
+        {
+            mapping[i] = static_cast<int32_t>(kept.size());
+            kept.emplace_back(std::move(clusters[i]));
+        }
+    }
+    for (unsigned i = 0; i < mapping.size(); ++i) {
+        if (into[i] >= 0)
+            mapping[i] = mapping[into[i]];
+    }
+    swap(kept, clusters);
+    relabel(mapping, static_cast<unsigned>(clusters.size()));
+}
+
+/**
+ * 合并操作 合并id1 id2的聚类，统计量直接相加
+ */
+void dist_isodata::merge(const int &id1, const int &id2) {
+    auto &c1 = clusters[id1];
+    auto &c2 = clusters[id2];
+    c1.center = (c1.center * c1.n + c2.center * c2.n) / (c1.n + c2.n);
+    c1.sum += c2.sum;
+    c1.sumsq += c2.sumsq;
+    c1.n += c2.n;
+    c2.n = 0;
+}
+
+/**
+ * 根据情况选择下一步操作
+ */
+void dist_isodata::switch_method(const int &index) {
+    if (index == _ns-1)
+    {
+        _tc = 0;
+        check_merge();
+    } else if (clusters.size() <= _c/2)
+    {
+        check_split();
+    } else if (index % 2 == 0 || clusters.size() >= 2*_c)
+    {
+        check_merge();
+    } else
+    {
+        check_split();
+    }
+}
+
+/**
+ * 输出聚类分析的结果，样本分布在各分片中，只输出各聚类的规模与中心
+ */
+void dist_isodata::output() const {
+    cout << "Original Data Number : " << row << endl;
+    cout << "Shard Number : " << workers.size() << endl;
+    cout << "Cluster Number : " << clusters.size() << endl;
+    for (int i = 0; i < clusters.size(); ++i) {
+        cout << "Number " << to_string(i+1) << " : " << static_cast<unsigned long long>(clusters[i].n) << endl;
+        cout << "cluster center : " << clusters[i].center << endl;
+    }
+}
@@ -0,0 +1,137 @@
+//
+// Created by Jeff on 2019/1/20 0020.
+//
+
+#ifndef ISODATA_DISTRIBUTED_H
+#define ISODATA_DISTRIBUTED_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <sys/types.h>
+#include "protocol.h"
+
+using namespace std;
+
+// 分布式(多进程)的ISODATA
+// 样本按行分片，每个分片进程持有一个分片，协调进程只保存每个聚类的充分统计量
+// (样本数、各维的和、各维的平方和、距离和)，并集中完成check_tn/check_split/check_merge的判断，
+// 判断的规则与isodata完全相同。进程之间通过Unix套接字对以protocol.h中的二进制协议通信，
+// 因此可以在一台Linux机器上用多个进程运行
+
+/**
+ * 协调进程中保存的聚类信息
+ */
+struct dist_cluster {
+    vector<double> center; // 聚类中心
+    vector<double> sigma; // 每个维度的标准差，定义与Cluster::sigma相同
+    vector<double> sum; // 各维的和
+    vector<double> sumsq; // 各维的平方和
+    double n; // 样本数
+    double innerMeanDis; // 类内平均距离
+    explicit dist_cluster(const vector<double> &c):
+        center(c), sigma(c.size(), 0), sum(c.size(), 0), sumsq(c.size(), 0), n(0), innerMeanDis(0) {}
+};
+
+class dist_isodata {
+private:
+    // 读取分片数据的函数，输入分片序号与分片总数，返回该分片的样本
+    typedef function<vector<vector<double>>(unsigned, unsigned)> SHARDFUNC;
+    struct worker {
+        pid_t pid;
+        int fd;
+    };
+    unsigned _c; // 预期的聚类个数
+    unsigned _nc; // 初始聚类中心数目
+    unsigned _tn; // 每一类中允许的样本最少数目
+    double _te; // 类内相对标准差上限
+    double _tc; // 聚类中心点之间的最小距离
+    unsigned _nt; // 每次迭代中最多可以合并的次数
+    unsigned _ns; // 最多迭代次数
+    unsigned _nw; // 分片进程个数
+    unsigned long long row; // 全部样本个数
+    unsigned col; // 特征个数
+    double allMeanDis; // 总体平均距离
+    deque<dist_cluster> clusters;
+    vector<worker> workers;
+    SHARDFUNC shard_func;
+    double alpha; // 分裂系数
+    bool ok; // 通信是否正常
+    unsigned seed; // 随机数种子
+    bool fixed_seed; // 是否使用固定的种子，否则使用当前时间
+public:
+    /**
+     * 构造函数，参数含义与isodata相同
+     * @param _nw 分片进程个数
+     * @param func 读取分片数据的函数，在分片进程中调用
+     */
+    explicit dist_isodata(unsigned int c, unsigned int _nc, unsigned int _tn,
+                          double _te, double _tc, unsigned int _nt,
+                          unsigned int _ns, unsigned int _nw, SHARDFUNC func) :
+                          _c(c), _nc(_nc), _tn(_tn),
+                          _te(_te), _tc(_tc), _nt(_nt),
+                          _ns(_ns), _nw(_nw == 0 ? 1 : _nw), row(0), col(0), allMeanDis(0),
+                          clusters(), workers(), shard_func(std::move(func)), alpha(0.3), ok(true),
+                          seed(0), fixed_seed(false) {
+    }
+    dist_isodata(const dist_isodata &) = delete;
+    dist_isodata &operator=(const dist_isodata &) = delete;
+    ~dist_isodata();
+
+    /**
+     * 固定初始化聚类中心使用的随机数种子，缺省使用当前时间
+     */
+    void set_seed(unsigned s)
+    {
+        seed = s;
+        fixed_seed = true;
+    }
+
+    /**
+     * 聚类结果：各聚类的统计量与中心，总体平均距离，运行中通信是否一直正常
+     */
+    const deque<dist_cluster> &get_clusters() const { return clusters; }
+    double mean_distance() const { return allMeanDis; }
+    bool good() const { return ok; }
+
+    void run()
+    {
+        if (!start_workers())
+            return;
+        init_clusters();
+        for (int i = 0; i < _ns && ok; ++i) {
+            re_assign();
+            check_tn();
+            update_centers();
+            update_meandis();
+            switch_method(i);
+        }
+        output();
+        stop_workers();
+    }
+
+private:
+    bool start_workers();
+    void stop_workers();
+    bool request(uint32_t type, const vector<msg_buffer> &payloads, vector<msg_buffer> &replies);
+    bool broadcast(uint32_t type, const msg_buffer &payload, vector<msg_buffer> &replies);
+    bool consumed(const vector<msg_buffer> &replies);
+    void put_centers(msg_buffer &out) const;
+    void read_stats(vector<msg_buffer> &replies, const vector<unsigned> &which);
+    void relabel(const vector<int32_t> &mapping, unsigned newk);
+    void init_clusters();
+    void re_assign();
+    void check_tn();
+    void update_centers();
+    void update_sigma(dist_cluster &cluster);
+    void update_meandis();
+    void check_split();
+    bool split(const int &c_index);
+    void check_merge();
+    void merge(const int &id1, const int &id2);
+    void switch_method(const int &index);
+    void output() const;
+};
+
+
+#endif //ISODATA_DISTRIBUTED_H
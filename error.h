@@ -14,8 +14,13 @@ using std::string;
 const string WARN_DATA_SIZE("Data size error");
 const string WARN_VECTOR_SIZE("Vector size error");
 const string WARN_FILE_OPEN_FAIL("Fail to open file");
+const string WARN_FILE_WRITE_FAIL("Fail to write file");
 const string WARN_POINT_REPEAT("Index repeat");
 const string WARN_CLUSTER_SIZE_SMALL("Cluster size too small");
+const string WARN_IPC_FAIL("Inter-process communication error");
+const string WARN_MEMORY_BUDGET("Memory budget exceeded");
+const string WARN_MODE_DISABLED("Memory budget disables NUMA/quantized assignment");
+const string WARN_INGEST_UNSUPPORTED("Ingest needs dense data owned by isodata and a finished run()");
 #endif //ISODATA_ERROR_H
 
 #pragma clang diagnostic pop
\ No newline at end of file
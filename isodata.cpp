@@ -6,7 +6,25 @@
 #include <queue>
 #include <algorithm>
 #include <fstream>
+#include <chrono>
 
+// 逐聚类的阶段中每片的样本数，大聚类按哈希桶切成多片
+static const size_t piece_rows = 2048;
+// 对角马氏距离中各维方差的下限，相对于该聚类各维方差的均值
+static const double var_floor = 1e-3;
+
+/**
+ * 对一片内的每个样本id调用f
+ */
+template <typename P, typename F>
+static void for_each_id(const P &p, F f)
+{
+    auto &ids = p.cluster->ids;
+    for (size_t b = p.b0; b < p.b1; ++b) {
+        for (auto it = ids.begin(b); it != ids.end(b); ++it)
+            f(*it);
+    }
+}
 
 /**
 * 设置读入数据
@@ -14,6 +32,13 @@
 */
 void isodata::setData()
 {
+    if (view)
+    {
+        // set_rows已经给出了行列数
+        if (row < _c || row < _tn)
+            cout << WARN_DATA_SIZE << endl;
+        return;
+    }
     data = std::move(read_func());
     if (data.size() < _c || data.size() < _tn)
     {
@@ -34,12 +59,272 @@ void isodata::setData()
     }
 }
 
+/**
+ * 读入稀疏数据
+ */
+void isodata::setSparseData()
+{
+    sdata = sparse_func();
+    if (sdata.rows < _c || sdata.rows < _tn)
+    {
+        cout << WARN_DATA_SIZE << endl;
+        return;
+    }
+    row = sdata.rows;
+    col = sdata.cols;
+}
+
+/**
+ * 估计rows个样本运行时的内存字节数
+ * 每个样本：样本本身(double存储时另有vector头与堆块头)，id集合中的一个哈希节点与桶指针，迭代内的一个标签；
+ * double存储时另加re_assign将要建立的样本副本：NUMA分片中的一行、权重与标签，或量化的编码与误差
+ * @param flat 是否按float连续存储，紧凑存储时不使用这两种副本
+ */
+size_t isodata::estimate_bytes(size_t rows, bool flat) const {
+    size_t per = flat ? col * sizeof(float) : col * sizeof(double) + sizeof(vector<double>) + 16;
+    per += 4 * sizeof(void *) + sizeof(unsigned);
+    if (!weights.empty())
+        per += sizeof(double);
+    const bool copies = !flat && !sparse && metric != METRIC_DIAGONAL;
+    if (copies && numa_cfg.enabled)
+        per += col * sizeof(double) + sizeof(unsigned) + (weights.empty() ? 0 : sizeof(double));
+    else if (copies && quantized)
+        per += col + sizeof(float);
+    return rows * per;
+}
+
+/**
+ * 样本改为按行连续的float存储，释放data
+ */
+void isodata::compact_samples() {
+    fdata.reserve(max(fdata.size(), data.size() * col));
+    for (auto &line : data)
+        fdata.insert(fdata.end(), line.begin(), line.end());
+    vector<vector<double>>().swap(data);
+    compact = true;
+    // 这两种方式都需要另外的样本副本
+    if (numa_cfg.enabled || quantized)
+        cout << WARN_MODE_DISABLED << endl;
+    numa_cfg.enabled = false;
+    numa.reset();
+    quantized = false;
+    qstore = sq8_store();
+}
+
+/**
+ * 数据载入之后检查内存预算，估计超出时改为紧凑存储，仍超出时警告
+ * @param held_rows 另外按double保留的样本数(coreset时的全部数据，refine要用)，
+ * 这时样本不能紧凑存储，只检查coreset上的运行与refine时的全部数据之和
+ */
+void isodata::apply_budget(size_t held_rows) {
+    if (mem_budget == 0 || sparse || view)
+        return;
+    if (held_rows > 0)
+    {
+        if (!over_budget && estimate_bytes(row, false) + estimate_bytes(held_rows, false) > mem_budget)
+        {
+            cout << WARN_MEMORY_BUDGET << endl;
+            over_budget = true;
+        }
+        return;
+    }
+    if (!compact && estimate_bytes(row, false) > mem_budget)
+        compact_samples();
+    if (compact && !over_budget && estimate_bytes(row, true) > mem_budget)
+    {
+        cout << WARN_MEMORY_BUDGET << endl;
+        over_budget = true;
+    }
+}
+
+/**
+ * 更新按类别统计的内存
+ * 样本按容量计算，double存储时每行另计vector头与堆块头；
+ * 成员关系与临时数据取自各自内存池上游的实际占用
+ */
+void isodata::account_memory() const {
+    size_t samples = weights.capacity() * sizeof(double);
+    if (compact)
+        samples += fdata.capacity() * sizeof(float);
+    else
+        samples += data.capacity() * sizeof(vector<double>) + data.size() * (col * sizeof(double) + 16);
+    if (sparse)
+        samples += sdata.indptr.capacity() * sizeof(size_t) + sdata.indices.capacity() * sizeof(unsigned)
+                   + (sdata.values.capacity() + sdata.sqnorm.capacity()) * sizeof(double);
+    samples += qstore.bytes();
+    if (numa)
+        samples += numa->bytes();
+    mem.set(MEM_SAMPLES, samples);
+    mem.set(MEM_MEMBERSHIP, id_res.in_use() + last_labels.capacity() * sizeof(unsigned));
+    size_t centers = clusters.size() * sizeof(Cluster);
+    for (auto &cluster : clusters) {
+        centers += (cluster.center.capacity() + cluster.sigma.capacity()
+                    + cluster.stats.sum.capacity() + cluster.stats.sumsq.capacity()) * sizeof(double);
+    }
+    centers += inv_var.capacity() * sizeof(double);
+    mem.set(MEM_CENTERS, centers);
+    mem.set(MEM_SCRATCH, sys_res.in_use() + marks.capacity());
+    // 两次统计之间的峰值由内存池上游记录
+    mem.peak[MEM_MEMBERSHIP] = max(mem.peak[MEM_MEMBERSHIP], id_res.peak_bytes());
+    mem.peak[MEM_SCRATCH] = max(mem.peak[MEM_SCRATCH], sys_res.peak_bytes());
+}
+
+/**
+ * 样本到聚类中心的欧式距离
+ * 稀疏数据按 |x|^2 + |c|^2 - 2x·c 计算，|c|^2 缓存在cluster.sqnorm中
+ */
+double isodata::point_distance(unsigned id, const Cluster &cluster) const {
+    if (compact || view)
+    {
+        double res(0);
+        with_row(id, [&](const auto *x) {
+            for (unsigned i = 0; i < col; ++i) {
+                double d = x[i] - cluster.center[i];
+                res += d * d;
+            }
+        });
+        return sqrt(res);
+    }
+    if (!sparse)
+        return get_distance(data[id], cluster.center);
+    auto d = sdata.sqnorm[id] + cluster.sqnorm - 2 * sdata.dot(id, cluster.center);
+    return sqrt(max(d, 0.0));
+}
+
+/**
+ * 重新分配时样本到第j个聚类的距离
+ * 对角马氏距离的权重按聚类连续存放，内层循环是连续数组上的乘加，便于向量化。
+ * 权重与当前的聚类不对应时(还没有计算过)按欧式距离
+ */
+double isodata::assign_distance(unsigned id, unsigned j) const {
+    if (metric != METRIC_DIAGONAL || sparse || inv_var.size() != clusters.size() * col)
+        return point_distance(id, clusters[j]);
+    const double *w = inv_var.data() + static_cast<size_t>(j) * col;
+    const double *c = clusters[j].center.data();
+    double res(0);
+    with_row(id, [&](const auto *x) {
+        for (unsigned i = 0; i < col; ++i) {
+            double d = x[i] - c[i];
+            res += w[i] * d * d;
+        }
+    });
+    return sqrt(res);
+}
+
+/**
+ * 由各聚类的标准差计算对角马氏距离的权重 w = g/sigma^2，g为该聚类各维sigma^2的几何平均
+ * 每个聚类的权重之积为1，度量只改变形状不改变体积，方差大的聚类不会因此吸走周围的样本；
+ * sigma随样本数增长的倍数也因此约去。标准差还没有计算过的聚类权重全为1
+ */
+void isodata::update_inv_var() {
+    const size_t k = clusters.size();
+    inv_var.assign(k * col, 1.0);
+    for (size_t j = 0; j < k; ++j) {
+        auto &sigma = clusters[j].sigma;
+        if (sigma.size() != col)
+            continue;
+        double mean(0);
+        for (auto v : sigma)
+            mean += v * v;
+        mean /= col;
+        if (mean <= 0)
+            continue;
+        double *w = inv_var.data() + j * col;
+        double logsum(0);
+        for (unsigned i = 0; i < col; ++i) {
+            w[i] = max(sigma[i] * sigma[i], mean * var_floor);
+            logsum += log(w[i]);
+        }
+        const double g = exp(logsum / col);
+        for (unsigned i = 0; i < col; ++i)
+            w[i] = g / w[i];
+    }
+}
+
+/**
+ * 与上一次重新分配的结果比较，记录是否有样本改变了所属聚类
+ * 分裂、合并与删除聚类会改变编号，因此只比较划分：
+ * 上一次的每个聚类与这一次的每个聚类一一对应时没有改变
+ */
+void isodata::track_labels(const unsigned *labels) {
+    const auto k = static_cast<unsigned>(clusters.size());
+    if (last_labels.size() != row)
+    {
+        last_labels.assign(labels, labels + row);
+        last_k = k;
+        labels_changed = true;
+        return;
+    }
+    const unsigned none = ~0u;
+    pmr::vector<unsigned> fwd(last_k, none, &arena); // 上一次的编号对应的这一次的编号
+    pmr::vector<unsigned> back(k, none, &arena);
+    labels_changed = false;
+    for (unsigned i = 0; i < row; ++i) {
+        auto a = last_labels[i], b = labels[i];
+        if (fwd[a] == none && back[b] == none)
+        {
+            fwd[a] = b;
+            back[b] = a;
+        } else if (fwd[a] != b || back[b] != a)
+            labels_changed = true;
+        last_labels[i] = b;
+    }
+    last_k = k;
+}
+
+/**
+ * 两个样本是否完全相同
+ */
+bool isodata::same_point(unsigned a, unsigned b) const {
+    if (compact)
+        return equal(fdata.begin() + static_cast<size_t>(a) * col, fdata.begin() + static_cast<size_t>(a + 1) * col,
+                     fdata.begin() + static_cast<size_t>(b) * col);
+    if (view)
+        return equal(view + static_cast<size_t>(a) * col, view + static_cast<size_t>(a + 1) * col,
+                     view + static_cast<size_t>(b) * col);
+    if (!sparse)
+        return data[a] == data[b];
+    return sdata.same_row(a, b);
+}
+
+/**
+ * 样本的稠密形式，用于初始化聚类中心
+ */
+vector<double> isodata::dense_point(unsigned id) const {
+    if (compact)
+        return vector<double>(fdata.begin() + static_cast<size_t>(id) * col, fdata.begin() + static_cast<size_t>(id + 1) * col);
+    if (view)
+        return vector<double>(view + static_cast<size_t>(id) * col, view + static_cast<size_t>(id + 1) * col);
+    if (!sparse)
+        return data[id];
+    return sdata.dense_row(id);
+}
+
+/**
+ * 更新缓存的聚类中心平方范数，中心改变后调用
+ */
+void isodata::update_norm(Cluster &cluster) const {
+    double res(0);
+    for (auto &v : cluster.center)
+        res += v * v;
+    cluster.sqnorm = res;
+}
+
+/**
+ * 随机数种子，设置了固定种子或者处于可复现模式时不使用当前时间
+ */
+unsigned isodata::rand_seed() const {
+    if (fixed_seed || deterministic)
+        return seed;
+    return static_cast<unsigned int>(time(nullptr));
+}
+
 /**
  * 初始化 随机选取_nc个聚类中心
  */
 void isodata::init_clusters() {
     // 选取随机id
-    std::default_random_engine rand(static_cast<unsigned int>(time(nullptr)));
+    std::default_random_engine rand(rand_seed());
     std::uniform_int_distribution<unsigned> rnd(0, row-1);
     unordered_set<unsigned> ids;
     while (ids.size() < _nc)
@@ -49,7 +334,7 @@ void isodata::init_clusters() {
         bool flg = false;
         for (auto &item : ids)
         {
-            if (get_distance(data[item], data[id]) == 0.0)
+            if (same_point(item, id))
                 flg = true;
         }
         if (!flg)
@@ -58,9 +343,131 @@ void isodata::init_clusters() {
     // 初始化聚类
     for (auto &id : ids)
     {
-        clusters.emplace_back(Cluster{this->data[id]});
+        auto &&c = dense_point(id);
+        clusters.emplace_back(c, &id_pool);
+        update_norm(clusters.back());
+    }
+
+}
+
+/**
+ * 从候选样本中随机选取互不重复的聚类中心，直到达到_nc个
+ * @param candidates 候选样本的id，会被打乱
+ * @return 是否已经有_nc个聚类中心
+ */
+bool isodata::seed_from(vector<unsigned> &candidates, std::default_random_engine &rand) {
+    shuffle(candidates.begin(), candidates.end(), rand);
+    for (auto &id : candidates)
+    {
+        if (clusters.size() >= _nc)
+            break;
+        bool flg = false;
+        for (auto &cluster : clusters)
+        {
+            if (point_distance(id, cluster) == 0.0)
+                flg = true;
+        }
+        if (!flg)
+        {
+            auto &&c = dense_point(id);
+            clusters.emplace_back(c, &id_pool);
+            update_norm(clusters.back());
+        }
     }
+    return clusters.size() >= _nc;
+}
 
+/**
+ * 异步读取数据
+ * 读取线程解析的数据块一到达就并入data，同时对到达的样本做蓄水池抽样；
+ * 读到seed_rows行后用蓄水池样本初始化聚类中心，此后的数据块一到达就分配到最近的聚类，
+ * 这样数据读完时第一次分配也已经完成
+ * 与setData相同，各行的维数不一致时丢弃全部数据
+ * @return 第一次分配是否已经完成，读取失败或数据不可用时返回false
+ */
+bool isodata::ingest_async() {
+    chunk_reader reader(async_path, async_chunk_rows);
+    reader.start();
+    std::default_random_engine rand(rand_seed());
+    const size_t window = seed_rows ? seed_rows : 64 * static_cast<size_t>(_nc);
+    const size_t capacity = 4 * static_cast<size_t>(_nc);
+    vector<unsigned> reservoir;
+    size_t seen(0), assigned(0);
+    bool seeded = false;
+    auto reject = [this]() {
+        vector<vector<double>>().swap(data);
+        vector<float>().swap(fdata);
+        clusters.clear();
+        stats_valid = false;
+        row = 0;
+        return false;
+    };
+    data_chunk chunk;
+    while (reader.pop(chunk))
+    {
+        for (auto &line : chunk.rows) {
+            if (col == 0)
+                col = static_cast<unsigned int>(line.size());
+            if (line.size() != col)
+            {
+                cout << WARN_DATA_SIZE << endl;
+                return reject();
+            }
+            if (compact)
+                fdata.insert(fdata.end(), line.begin(), line.end());
+            else
+                data.emplace_back(std::move(line));
+            // 蓄水池抽样
+            auto id = static_cast<unsigned>(sample_count() - 1);
+            if (reservoir.size() < capacity)
+                reservoir.push_back(id);
+            else
+            {
+                std::uniform_int_distribution<size_t> rnd(0, seen);
+                auto k = rnd(rand);
+                if (k < capacity)
+                    reservoir[k] = id;
+            }
+            ++seen;
+        }
+        // 超出内存预算时在读取过程中改为紧凑存储
+        if (!compact && mem_budget > 0 && coreset_size == 0 && estimate_bytes(seen, false) > mem_budget)
+            compact_samples();
+        account_memory();
+        if (!seeded && seen >= window)
+        {
+            // 蓄水池中互不重复的样本不够时，继续读取后再补充
+            seeded = seed_from(reservoir, rand);
+        }
+        if (seeded)
+        {
+            for (; assigned < sample_count(); ++assigned) {
+                auto id = static_cast<unsigned>(assigned);
+                clusters[get_nearest_cluster(static_cast<int>(id)).first].add_point(static_cast<int>(id), weight(id));
+            }
+        }
+    }
+    // 打开失败时读取线程已经输出了警告
+    if (reader.failed())
+        return reject();
+    row = static_cast<unsigned int>(sample_count());
+    if (row < _c || row < _tn || row < _nc)
+    {
+        cout << WARN_DATA_SIZE << endl;
+        return reject();
+    }
+    if (!seeded)
+    {
+        vector<unsigned> all(row);
+        for (unsigned i = 0; i < row; ++i)
+            all[i] = i;
+        seed_from(all, rand);
+    }
+    for (; assigned < sample_count(); ++assigned) {
+        auto id = static_cast<unsigned>(assigned);
+        clusters[get_nearest_cluster(static_cast<int>(id)).first].add_point(static_cast<int>(id), weight(id));
+    }
+    return true;
 }
 
 /**
@@ -69,15 +476,15 @@ void isodata::init_clusters() {
  * @ignore 设置忽略序号， 缺省为-1， 主要用于删除聚类时使用
  * @return 序号+距离
  */
-pair<int, double> isodata::get_nearest_cluster(int p_index, int ignore = -1) {
+pair<int, double> isodata::get_nearest_cluster(int p_index, int ignore) {
     if (ignore != -1 && clusters.size() == 1)
         cout << WARN_CLUSTER_SIZE_SMALL << endl;
     int c_index = 0;
-    double dis(get_distance(data[p_index], clusters[c_index].center));
+    double dis(assign_distance(p_index, c_index));
     for (int i = 1; i < clusters.size(); ++i) {
         if (ignore != -1 && i == ignore)
             continue;
-        auto d = get_distance(data[p_index], clusters[i].center);
+        auto d = assign_distance(p_index, i);
         if (d < dis)
         {
             dis = d;
@@ -92,18 +499,18 @@ pair<int, double> isodata::get_nearest_cluster(int p_index, int ignore = -1) {
  * @param cluster_ids 一个集合，集合内的聚类中心不做考虑
  * @return 序号+距离
  */
-pair<int, double> isodata::get_nearest_cluster(int p_index, unordered_set<unsigned> &cluster_ids) {
+pair<int, double> isodata::get_nearest_cluster(int p_index, const pmr::unordered_set<unsigned> &cluster_ids) {
     // 选择第一个不在cluster_ids中的聚类
     int c_index = 0;
     while (cluster_ids.find(static_cast<const unsigned int &>(c_index)) != cluster_ids.end())
         ++c_index;
     //初始一个距离
-    double dis(get_distance(data[p_index], clusters[c_index].center));
-    for (int i = c_index+1;
-    i < clusters.size() && (cluster_ids.find(static_cast<const unsigned int &>(i)) == cluster_ids.end());
-    ++i)
+    double dis(assign_distance(p_index, c_index));
+    for (int i = c_index+1; i < clusters.size(); ++i)
     {
-        auto d = get_distance(data[p_index], clusters[i].center);
+        if (cluster_ids.find(static_cast<const unsigned int &>(i)) != cluster_ids.end())
+            continue;
+        auto d = assign_distance(p_index, i);
         if (d < dis)
         {
             dis = d;
@@ -113,6 +520,57 @@ pair<int, double> isodata::get_nearest_cluster(int p_index, unordered_set<unsign
     return {c_index, dis};
 }
 
+/**
+ * 构造coreset，全部数据移到full中，data与weights换成coreset
+ * 已经初始化的聚类(异步读取时)作废，在coreset上重新初始化
+ * @param full 输出，全部数据
+ */
+void isodata::build_coreset(vector<vector<double>> &full) {
+    auto &&ids = lightweight_coreset(data, coreset_size, rand_seed(), weights);
+    vector<vector<double>> sample;
+    sample.reserve(ids.size());
+    for (auto &id : ids)
+        sample.push_back(data[id]);
+    full = std::move(data);
+    data = std::move(sample);
+    row = static_cast<unsigned int>(data.size());
+    clusters.clear();
+    stats_valid = false;
+    // coreset中互不重复的样本可能少于_nc，不能用init_clusters的拒绝采样
+    vector<unsigned> all(row);
+    for (unsigned i = 0; i < row; ++i)
+        all[i] = i;
+    std::default_random_engine rand(rand_seed());
+    seed_from(all, rand);
+}
+
+/**
+ * coreset上的迭代结束后，换回全部数据，重新分配并更新中心
+ * 只做分配与更新，不再分裂/合并，聚类的结构由coreset上的结果决定
+ */
+void isodata::refine(vector<vector<double>> &full) {
+    data = std::move(full);
+    weights.clear();
+    row = static_cast<unsigned int>(data.size());
+    for (unsigned i = 0; i < refine_passes; ++i) {
+        re_assign();
+        check_tn();
+        update_centers();
+        update_meandis();
+        arena.reset();
+    }
+    update_sigmas();
+}
+
+/**
+ * 聚类的样本数，带权重时为加入样本时累计的权重之和
+ */
+double isodata::mass(const Cluster &cluster) const {
+    if (weights.empty())
+        return static_cast<double>(cluster.ids.size());
+    return cluster.weight;
+}
+
 /**
  * 依据距离最小原则重新分配点
  */
@@ -120,34 +578,146 @@ void isodata::re_assign() {
     for (auto &cluster : clusters) {
         cluster.clear_ids();
     }
-    for (int i = 0; i < row; ++i) {
-        auto&& res = get_nearest_cluster(i);
-        clusters[res.first].add_point(i);
+    stats_valid = false;
+    // NUMA分配与量化分配只实现了欧式距离
+    const bool diagonal = metric == METRIC_DIAGONAL && !sparse;
+    if (numa_cfg.enabled && !sparse && !compact && !view && !diagonal)
+    {
+        re_assign_numa();
+        return;
+    }
+    if (quantized && !sparse && !compact && !view && !diagonal)
+    {
+        re_assign_quantized();
+        return;
     }
+    if (diagonal)
+        update_inv_var();
+    // 并行查找最近中心，再按样本顺序加入聚类
+    pmr::vector<unsigned> labels(row, &arena);
+    sched->parallel_for("assign", row, 1024, [&](size_t begin, size_t end, unsigned) {
+        for (auto i = begin; i < end; ++i)
+            labels[i] = static_cast<unsigned>(get_nearest_cluster(static_cast<int>(i)).first);
+    });
+    track_labels(labels.data());
+    for (unsigned i = 0; i < row; ++i)
+        clusters[labels[i]].add_point(static_cast<int>(i), weight(i));
+}
+
+/**
+ * NUMA感知的并行分配，分配结果与统计量由numa_assigner计算，
+ * 这里只按结果把样本加入各聚类
+ */
+void isodata::re_assign_numa() {
+    auto start = chrono::steady_clock::now();
+    if (!numa)
+    {
+        numa.reset(new numa_assigner(numa_cfg));
+        numa->set_deterministic(deterministic);
+    }
+    if (numa->source() != data.data() || numa->rows() != row)
+        numa->place(data, weights);
+    const auto k = static_cast<unsigned>(clusters.size());
+    pmr::vector<double> centers(static_cast<size_t>(k) * col, &arena);
+    for (unsigned j = 0; j < k; ++j)
+        copy(clusters[j].center.begin(), clusters[j].center.end(), centers.begin() + static_cast<size_t>(j) * col);
+    numa->assign(centers.data(), k);
+    auto &labels = numa->labels();
+    track_labels(labels.data());
+    for (unsigned i = 0; i < row; ++i)
+        clusters[labels[i]].add_point(static_cast<int>(i), weight(i));
+    stats_valid = true;
+    sched->record("assign_numa", chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * 在量化样本上查找最近中心
+ * 量化距离与真实距离之差不超过该样本的量化误差e=qstore.row_error(i)，
+ * 最近与次近的量化距离相差超过2e时最近中心确定无误，否则对量化距离在最近距离+2e以内的中心用原数据计算
+ */
+void isodata::re_assign_quantized() {
+    if (qstore.source() != data.data() || qstore.rows() != row)
+        qstore.build(data);
+    const auto k = static_cast<unsigned>(clusters.size());
+    pmr::vector<float> qc(static_cast<size_t>(k) * col, &arena);
+    // 每个线程一份量化距离与复核计数
+    pmr::vector<float> dist(static_cast<size_t>(k) * sched->size(), &arena);
+    pmr::vector<unsigned long long> counts(sched->size(), 0, &arena);
+    pmr::vector<unsigned> labels(row, &arena);
+    for (unsigned j = 0; j < k; ++j)
+        qstore.encode_center(clusters[j].center, qc.data() + static_cast<size_t>(j) * col);
+    sched->parallel_for("assign", row, 1024, [&](size_t begin, size_t end, unsigned w) {
+        float *d2 = dist.data() + static_cast<size_t>(k) * w;
+        for (auto i = static_cast<unsigned>(begin); i < end; ++i) {
+            const double tol = 2 * qstore.row_error(i);
+            unsigned best = 0;
+            float b = 0, second = 0;
+            for (unsigned j = 0; j < k; ++j) {
+                d2[j] = qstore.distance2(i, qc.data() + static_cast<size_t>(j) * col);
+                if (j == 0 || d2[j] < b)
+                {
+                    second = j == 0 ? d2[j] : b;
+                    b = d2[j];
+                    best = j;
+                } else if (j == 1 || d2[j] < second)
+                    second = d2[j];
+            }
+            const double db = sqrt(static_cast<double>(b));
+            // float累加的相对误差另留余量
+            const double bound = db + tol + 1e-5 * db;
+            if (k > 1 && sqrt(static_cast<double>(second)) <= bound)
+            {
+                ++counts[w];
+                double dis = 0;
+                bool first = true;
+                for (unsigned j = 0; j < k; ++j) {
+                    if (sqrt(static_cast<double>(d2[j])) > bound)
+                        continue;
+                    auto d = point_distance(i, clusters[j]);
+                    if (first || d < dis)
+                    {
+                        dis = d;
+                        best = j;
+                        first = false;
+                    }
+                }
+            }
+            labels[i] = best;
+        }
+    });
+    for (auto c : counts)
+        reranks += c;
+    track_labels(labels.data());
+    for (unsigned i = 0; i < row; ++i)
+        clusters[labels[i]].add_point(static_cast<int>(i), weight(i));
 }
 
 /**
  * 检测每个聚类中的个数是否少于_tn，如果少于则取消此类别
  */
 void isodata::check_tn() {
-    unordered_set<unsigned> to_erase;
+    pmr::unordered_set<unsigned> to_erase(&arena);
     for (int i = 0; i < clusters.size(); ++i) {
-        if (clusters[i].ids.size() >= _tn)
+        if (mass(clusters[i]) >= _tn)
             continue;
         to_erase.emplace(i);
+        stats_valid = false;
         auto &indexs = clusters[i].ids;
         for (unsigned int index : indexs) {
             auto &&res = get_nearest_cluster(index, to_erase);
-            clusters[res.first].add_point(index);
+            clusters[res.first].add_point(index, weight(index));
         }
-        clusters[i].ids.clear();
+        clusters[i].clear_ids();
 
     }
+    // _tn为0时空聚类也在这里删除，之后的聚类编号与统计量不再对应
     for (auto it = clusters.begin(); it != clusters.end();)
     {
         if (it->ids.empty())
+        {
             it = clusters.erase(it);
-        else
+            stats_valid = false;
+        } else
             ++it;
     }
 }
@@ -156,87 +726,249 @@ void isodata::check_tn() {
  * 更新各个聚类的中心坐标
  */
 void isodata::update_centers() {
-    for (auto &cluster : clusters)
+    if (stats_valid)
     {
-        update_center(cluster);
+        // 并行分配时已经汇总了每个聚类的加权和
+        auto &stats = numa->stats();
+        const size_t width = 1 + static_cast<size_t>(col);
+        for (unsigned j = 0; j < clusters.size(); ++j) {
+            auto &cluster = clusters[j];
+            const double *s = stats.data() + j * width;
+            cluster.center.assign(s + 1, s + width);
+            scale_inplace(cluster.center, 1 / s[0]);
+            update_norm(cluster);
+        }
+        return;
     }
+    pmr::vector<Cluster *> list(&arena);
+    for (auto &cluster : clusters)
+        list.push_back(&cluster);
+    update_centers(list.data(), list.size());
 }
 
 /**
- * 更新某个聚类的中心坐标
+ * 把若干聚类按哈希桶切成片，每片约piece_rows个样本
+ * 切法只取决于聚类本身，与线程数无关
  */
-void isodata::update_center(Cluster& cluster) {
-    vector<double> sum(col, 0);
-    for (auto &index : cluster.ids)
-    {
-        sum += data[index];
+void isodata::make_pieces(Cluster *const *list, size_t k, pmr::vector<piece> &out) const {
+    out.clear();
+    for (size_t j = 0; j < k; ++j) {
+        auto &ids = list[j]->ids;
+        const size_t nb = ids.bucket_count();
+        const size_t np = min(max<size_t>(ids.size() / piece_rows, 1), nb);
+        for (size_t p = 0; p < np; ++p)
+            out.push_back(piece{list[j], nb * p / np, nb * (p + 1) / np, static_cast<unsigned>(j)});
+    }
+}
+
+/**
+ * 更新若干聚类的中心坐标
+ * 每片累加权重与加权和，再按片的顺序汇总到各聚类。
+ * 使用对角马氏距离时每次迭代都需要标准差，同一遍中再累加加权平方和，
+ * 由 sum(w*(c-x)^2) = sum(w*x^2) - W*c^2 得到标准差，不再单独遍历一次
+ */
+void isodata::update_centers(Cluster *const *list, size_t k) {
+    pmr::vector<piece> pieces(&arena);
+    make_pieces(list, k, pieces);
+    const bool with_sq = metric == METRIC_DIAGONAL && !sparse;
+    const size_t width = 1 + static_cast<size_t>(col) * (with_sq ? 2 : 1);
+    pmr::vector<double> partial(pieces.size() * width, 0, &arena);
+    sched->parallel_for("centers", pieces.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        for (auto p = begin; p < end; ++p) {
+            double *acc = partial.data() + p * width;
+            for_each_id(pieces[p], [&](unsigned id) {
+                auto w = weight(id);
+                acc[0] += w;
+                if (sparse)
+                    sdata.add_to(id, acc + 1, w);
+                else
+                {
+                    with_row(id, [&](const auto *x) {
+                        if (with_sq)
+                        {
+                            double *sq = acc + 1 + col;
+                            for (unsigned i = 0; i < col; ++i) {
+                                double v = w * x[i];
+                                acc[1 + i] += v;
+                                sq[i] += v * x[i];
+                            }
+                        } else
+                        {
+                            for (unsigned i = 0; i < col; ++i)
+                                acc[1 + i] += w * x[i];
+                        }
+                    });
+                }
+            });
+        }
+    });
+    pmr::vector<double> masses(k, 0, &arena);
+    pmr::vector<double> sqsums(with_sq ? k * col : 0, 0, &arena);
+    for (size_t j = 0; j < k; ++j)
+        list[j]->center.assign(col, 0);
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        const double *acc = partial.data() + p * width;
+        const auto j = pieces[p].slot;
+        masses[j] += acc[0];
+        auto &sum = list[j]->center;
+        for (unsigned i = 0; i < col; ++i)
+            sum[i] += acc[1 + i];
+        if (with_sq)
+        {
+            for (unsigned i = 0; i < col; ++i)
+                sqsums[j * col + i] += acc[1 + col + i];
+        }
+    }
+    for (size_t j = 0; j < k; ++j) {
+        auto &cluster = *list[j];
+        scale_inplace(cluster.center, 1 / masses[j]);
+        update_norm(cluster);
+        if (with_sq)
+        {
+            cluster.sigma.resize(col);
+            for (unsigned i = 0; i < col; ++i) {
+                auto c = cluster.center[i];
+                cluster.sigma[i] = sqrt(max(sqsums[j * col + i] - masses[j] * c * c, 0.0));
+            }
+        }
     }
-    cluster.center = sum/ static_cast<double>(cluster.ids.size());
 }
 
 
+
 /**
  * 更新各个聚类的标准差
  */
 void isodata::update_sigmas() {
-    for ( auto& cluster : clusters) {
-        update_sigma(cluster);
-    }
+    pmr::vector<Cluster *> list(&arena);
+    for (auto &cluster : clusters)
+        list.push_back(&cluster);
+    update_sigmas(list.data(), list.size());
 }
 
 /**
- * 更新单个聚类的标准差
+ * 更新若干聚类的标准差
+ * 稠密数据每片累加 w*(c-x)^2；稀疏数据每片累加权重、sum(w*x)与sum(w*x^2)，
+ * 由 sum(w*(c-x)^2) = W*c^2 - 2*c*sum(w*x) + sum(w*x^2) 得到，只需遍历非零元
  */
-void isodata::update_sigma(Cluster& cluster) {
-    cluster.sigma.clear();
-    auto &sigma = cluster.sigma;
-    sigma.resize(col, 0);
-    for (auto& id : cluster.ids) {
-        sigma += mypow(cluster.center - data[id], 2);
+void isodata::update_sigmas(Cluster *const *list, size_t k) {
+    pmr::vector<piece> pieces(&arena);
+    make_pieces(list, k, pieces);
+    const size_t width = 1 + static_cast<size_t>(col) * (sparse ? 2 : 1);
+    pmr::vector<double> partial(pieces.size() * width, 0, &arena);
+    sched->parallel_for("sigmas", pieces.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        for (auto p = begin; p < end; ++p) {
+            double *acc = partial.data() + p * width;
+            auto &center = pieces[p].cluster->center;
+            for_each_id(pieces[p], [&](unsigned id) {
+                auto w = weight(id);
+                acc[0] += w;
+                if (sparse)
+                {
+                    sdata.add_to(id, acc + 1, w);
+                    sdata.add_sq_to(id, acc + 1 + col, w);
+                } else
+                {
+                    with_row(id, [&](const auto *x) {
+                        for (unsigned i = 0; i < col; ++i) {
+                            double d = center[i] - x[i];
+                            acc[1 + i] += w * d * d;
+                        }
+                    });
+                }
+            });
+        }
+    });
+    pmr::vector<double> sums(k * width, 0, &arena);
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        const double *acc = partial.data() + p * width;
+        double *sum = sums.data() + pieces[p].slot * width;
+        for (size_t i = 0; i < width; ++i)
+            sum[i] += acc[i];
+    }
+    for (size_t j = 0; j < k; ++j) {
+        auto &cluster = *list[j];
+        const double *sum = sums.data() + j * width;
+        auto &sigma = cluster.sigma;
+        sigma.assign(sum + 1, sum + 1 + col);
+        if (sparse)
+        {
+            for (unsigned i = 0; i < col; ++i) {
+                auto c = cluster.center[i];
+                sigma[i] = max(sum[0] * c * c - 2 * c * sum[1 + i] + sum[1 + col + i], 0.0);
+            }
+        }
+        sqrt_inplace(sigma);
     }
-    auto &&res(vector_sqrt(sigma));
-    swap(res, sigma);
 }
 
+
 /**
  * 更新平均距离
  */
 void isodata::update_meandis() {
-    Cluster::allMeanDis = 0;
-    for (auto &&cluster : clusters) {
-        double dis(0.0);
-        for (auto &id : cluster.ids) {
-            dis += get_distance(data[id], cluster.center);
+    pmr::vector<Cluster *> list(&arena);
+    for (auto &cluster : clusters)
+        list.push_back(&cluster);
+    pmr::vector<piece> pieces(&arena);
+    make_pieces(list.data(), list.size(), pieces);
+    // 每片的权重之和与加权距离之和
+    pmr::vector<double> partial(pieces.size() * 2, 0, &arena);
+    sched->parallel_for("meandis", pieces.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        for (auto p = begin; p < end; ++p) {
+            double *acc = partial.data() + p * 2;
+            for_each_id(pieces[p], [&](unsigned id) {
+                auto w = weight(id);
+                acc[0] += w;
+                acc[1] += w * point_distance(id, *pieces[p].cluster);
+            });
         }
-        Cluster::allMeanDis += dis;
-        cluster.innerMeanDis = dis/cluster.ids.size();
+    });
+    pmr::vector<double> sums(list.size() * 2, 0, &arena);
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        sums[pieces[p].slot * 2] += partial[p * 2];
+        sums[pieces[p].slot * 2 + 1] += partial[p * 2 + 1];
+    }
+    allMeanDis = 0;
+    double total(0);
+    for (size_t j = 0; j < list.size(); ++j) {
+        auto m = sums[j * 2];
+        auto dis = sums[j * 2 + 1];
+        allMeanDis += dis;
+        total += m;
+        list[j]->innerMeanDis = dis/m;
     }
-    Cluster::allMeanDis /= row;
+    allMeanDis /= weights.empty() ? row : total;
 }
 
 
 /**
  * 检测是否需要分裂，如果需要则执行分裂操作
+ * 分裂失败(新聚类没有分到样本)的聚类状态不变，不再重试，否则会反复分裂同一个聚类
  */
 void isodata::check_split() {
     update_sigmas();
+    pmr::vector<char> failed(clusters.size(), 0, &arena);
     while (true)
     {
         bool flag = false;
         for (unsigned j = 0; j < clusters.size(); ++j) {
-            auto& cluster = clusters[j];
-            for (int i = 0; i < col; ++i) {
-                if (cluster.innerMeanDis > Cluster::allMeanDis) {
-                    if (cluster.sigma[i] > _te && (cluster.ids.size() > 2 * _tn + 1 || clusters.size() < _c / 2)) {
-                        flag = true;
-                        split(j);
-                    }
-                } else {
-                    if (cluster.sigma[i] > _te && clusters.size() < _c / 2) {
-                        flag = true;
-                        split(j);
-                    }
-                }
+            for (int i = 0; i < col && !failed[j]; ++i) {
+                // 每个维度都重新取样本数，前面的维度可能已经分裂过
+                auto& cluster = clusters[j];
+                bool want;
+                if (cluster.innerMeanDis > allMeanDis)
+                    want = cluster.sigma[i] > _te && (mass(cluster) > 2 * _tn + 1 || clusters.size() < _c / 2);
+                else
+                    want = cluster.sigma[i] > _te && clusters.size() < _c / 2;
+                if (!want)
+                    continue;
+                if (split(j))
+                {
+                    flag = true;
+                    failed.push_back(0);
+                } else
+                    failed[j] = 1;
             }
         }
         if (!flag)
@@ -249,33 +981,57 @@ void isodata::check_split() {
 /**
  * 分裂第c_index个聚类
  * @param c_index
+ * @return 是否保留了新聚类，新聚类没有分到样本时返回false
  */
-void isodata::split(const int &c_index) {
+bool isodata::split(const int &c_index) {
     //根据标准差选取分裂维度
     auto& cluster = clusters[c_index];
     auto iter = max_element(cluster.sigma.begin(), cluster.sigma.end());
     auto pos = distance(cluster.sigma.begin(), iter);
-    Cluster newcluster(cluster.center);
+    Cluster newcluster(cluster.center, &id_pool);
     //分裂
     newcluster.center[pos] -= alpha*cluster.center[pos];
     cluster.center[pos] += alpha*cluster.center[pos];
-    for (const auto &id : cluster.ids) {
-        auto d1 = get_distance(data[id], cluster.center);
-        auto d2 = get_distance(data[id], newcluster.center);
-        if (d2 < d1)
-            newcluster.ids.emplace(id);
+    update_norm(cluster);
+    update_norm(newcluster);
+    // 并行比较到两个中心的距离并做标记，再把距离新中心更近的样本直接从原聚类中移出
+    if (marks.size() < row)
+        marks.assign(row, 0);
+    Cluster *list = &cluster;
+    pmr::vector<piece> pieces(&arena);
+    make_pieces(&list, 1, pieces);
+    sched->parallel_for("split", pieces.size(), 1, [&](size_t begin, size_t end, unsigned) {
+        for (auto p = begin; p < end; ++p) {
+            for_each_id(pieces[p], [&](unsigned id) {
+                marks[id] = point_distance(id, newcluster) < point_distance(id, cluster);
+            });
+        }
+    });
+    for (auto it = cluster.ids.begin(); it != cluster.ids.end();) {
+        if (marks[*it])
+        {
+            marks[*it] = 0;
+            newcluster.ids.emplace(*it);
+            newcluster.weight += weight(*it);
+            cluster.weight -= weight(*it);
+            it = cluster.ids.erase(it);
+        } else
+            ++it;
     }
-    unordered_set<unsigned> dids;
-    set_difference(cluster.ids.begin(), cluster.ids.end(),
-                   newcluster.ids.begin(), newcluster.ids.end(),
-                   inserter(dids, dids.begin()));
-    swap(dids, cluster.ids);
-    // 更新参数并保存新聚类
-    update_center(newcluster);
-    update_sigma(newcluster);
-    update_center(cluster);
-    update_sigma(cluster);
-    clusters.emplace_back(newcluster);
+    // 更新参数，没有分到样本的聚类不更新，没有分到样本的新聚类直接丢弃
+    Cluster *both[2];
+    size_t k = 0;
+    for (auto c : {&newcluster, &cluster}) {
+        if (!c->ids.empty())
+            both[k++] = c;
+    }
+    update_centers(both, k);
+    update_sigmas(both, k);
+    if (newcluster.ids.empty())
+        return false;
+    clusters.emplace_back(std::move(newcluster));
+    stats_valid = false;
+    return true;
 }
 
 
@@ -286,7 +1042,7 @@ void isodata::check_merge() {
     // 自定义数据类型
     typedef pair<pair<unsigned, unsigned>, double> UNIT;
     //1 计算聚类中心两两之间的距离，保留小于_tc的，并从小到达排序
-    vector<UNIT> uvec;
+    pmr::vector<UNIT> uvec(&arena);
     for (unsigned i = 0; i < clusters.size(); ++i) {
         for (unsigned j = i+1; j < clusters.size(); ++j) {
             auto dis = get_distance(clusters[i].center, clusters[j].center);
@@ -296,42 +1052,60 @@ void isodata::check_merge() {
     }
     sort(uvec.begin(), uvec.end(), [](UNIT& left, UNIT& right){ return left.second < right.second;});
     //2 执行合并操作
-    unordered_set<unsigned> clusterIds{};
+    pmr::unordered_set<unsigned> clusterIds(&arena);
     unsigned cnt(0);
     for (const auto &unit : uvec) {
+        // 每次迭代最多合并_nt次
+        if (cnt >= _nt)
+            break;
         auto& cids = unit.first;
-        auto& cdis = unit.second;
         if (clusterIds.find(cids.first) == clusterIds.end() &&
             clusterIds.find(cids.second) == clusterIds.end())
         {
             merge(cids.first, cids.second);
             clusterIds.emplace(cids.first);
             clusterIds.emplace(cids.second);
+            ++cnt;
         }
-        // 检测是否超过最大次数
-        if (++cnt > _ns)
-            break;
     }
     //3 清除被合并的聚类
     for (auto iter = clusters.begin(); iter != clusters.end();)
     {
         if (iter->ids.empty())
+        {
             iter = clusters.erase(iter);
-        else
+            stats_valid = false;
+        } else
             iter++;
     }
 }
 
 /**
- * 合并操作 合并id1 id2的聚类
+ * 合并操作 合并id1 id2的聚类，id2的样本并入id1
  * @param id1
  * @param id2
  */
 void isodata::merge(const int &id1, const int &id2) {
     auto &c1 = clusters[id1];
     auto &c2 = clusters[id2];
-    c1.center = (c1.center* c1.ids.size() + c2.center*c2.ids.size())/(c1.ids.size()+c2.ids.size());
-    c2.ids.clear();
+    auto n1 = mass(c1);
+    auto n2 = mass(c2);
+    if (metric == METRIC_DIAGONAL && !sparse && c1.sigma.size() == col && c2.sigma.size() == col)
+    {
+        // 对角度量依赖各维的标准差：两部分的平方偏差和相加，再加上两个中心到新中心的偏移，
+        // n1*d1^2 + n2*d2^2 = n1*n2/(n1+n2)*(c1-c2)^2，不必重新扫描样本
+        for (unsigned i = 0; i < col; ++i) {
+            auto d = c1.center[i] - c2.center[i];
+            c1.sigma[i] = sqrt(c1.sigma[i] * c1.sigma[i] + c2.sigma[i] * c2.sigma[i] + n1 * n2 / (n1 + n2) * d * d);
+        }
+    }
+    scale_inplace(c1.center, n1 / (n1 + n2));
+    add_scaled(c1.center, c2.center, n2 / (n1 + n2));
+    update_norm(c1);
+    for (auto id : c2.ids)
+        c1.add_point(static_cast<int>(id), weight(id));
+    c2.clear_ids();
+    stats_valid = false;
 }
 
 /**
@@ -354,31 +1128,384 @@ void isodata::switch_method(const int& index) {
     }
 }
 
+/**
+ * 由样本重新计算聚类的充分统计量与类内平均距离
+ */
+void isodata::rebuild_stats(Cluster &cluster) {
+    auto &st = cluster.stats;
+    st.weight = 0;
+    st.dissum = 0;
+    st.sum.assign(col, 0);
+    st.sumsq.assign(col, 0);
+    for (auto &id : cluster.ids) {
+        auto w = weight(id);
+        st.weight += w;
+        st.dissum += w * point_distance(id, cluster);
+        with_row(id, [&](const auto *x) {
+            for (unsigned i = 0; i < col; ++i) {
+                st.sum[i] += w * x[i];
+                st.sumsq[i] += w * x[i] * x[i];
+            }
+        });
+    }
+    cluster.innerMeanDis = st.dissum / st.weight;
+}
+
+/**
+ * 由充分统计量更新总体平均距离，只需遍历聚类
+ */
+void isodata::refresh_meandis() {
+    double dis(0), total(0);
+    for (auto &cluster : clusters) {
+        dis += cluster.stats.dissum;
+        total += cluster.stats.weight;
+    }
+    allMeanDis = dis / total;
+}
+
+/**
+ * 对第j个聚类按check_split的条件检测一次，需要时分裂
+ * 标准差由充分统计量得到：sum(w*(c-x)^2) = W*c^2 - 2*c*sum(w*x) + sum(w*x^2)
+ * @return 是否分裂，分裂出的聚类位于clusters末尾
+ */
+bool isodata::local_split(unsigned j) {
+    auto &cluster = clusters[j];
+    auto &st = cluster.stats;
+    cluster.sigma.resize(col);
+    for (unsigned i = 0; i < col; ++i) {
+        auto c = cluster.center[i];
+        cluster.sigma[i] = sqrt(max(st.weight * c * c - 2 * c * st.sum[i] + st.sumsq[i], 0.0));
+    }
+    if (*max_element(cluster.sigma.begin(), cluster.sigma.end()) <= _te)
+        return false;
+    if (cluster.innerMeanDis > allMeanDis) {
+        if (!(st.weight > 2 * _tn + 1 || clusters.size() < _c / 2))
+            return false;
+    } else if (clusters.size() >= _c / 2)
+        return false;
+    if (!split(static_cast<int>(j)))
+    {
+        rebuild_stats(clusters[j]);
+        return false;
+    }
+    rebuild_stats(clusters[j]);
+    rebuild_stats(clusters.back());
+    return true;
+}
+
+/**
+ * 检测which中的聚类与最近的聚类中心的距离，小于merge_dis时合并，合并后的样本并入前者
+ * 被合并的聚类留空，由调用者清除
+ * @param into 输出，每个聚类的样本现在所在的聚类
+ * @return 合并的次数
+ */
+unsigned isodata::local_merge(const pmr::vector<unsigned> &which, pmr::vector<unsigned> &into) {
+    into.resize(clusters.size());
+    for (unsigned i = 0; i < into.size(); ++i)
+        into[i] = i;
+    pmr::unordered_set<unsigned> used(&arena);
+    unsigned cnt(0);
+    for (auto j : which) {
+        if (cnt >= _nt || used.count(j) || clusters[j].ids.empty())
+            continue;
+        int best = -1;
+        double dis(0);
+        for (unsigned i = 0; i < clusters.size(); ++i) {
+            if (i == j || used.count(i) || clusters[i].ids.empty())
+                continue;
+            auto d = get_distance(clusters[j].center, clusters[i].center);
+            if (best == -1 || d < dis)
+            {
+                best = static_cast<int>(i);
+                dis = d;
+            }
+        }
+        if (best == -1 || dis >= merge_dis)
+            continue;
+        auto &c1 = clusters[j];
+        auto &c2 = clusters[best];
+        merge(static_cast<int>(j), best);
+        rebuild_stats(c1);
+        c2.stats = cluster_stats();
+        into[best] = j;
+        used.emplace(j);
+        used.emplace(static_cast<unsigned>(best));
+        ++cnt;
+    }
+    return cnt;
+}
+
+vector<int32_t> isodata::ingest(vector<vector<double>> rows) {
+    vector<int32_t> res(rows.size(), 0);
+    if (sparse || view || clusters.empty())
+    {
+        cout << WARN_INGEST_UNSUPPORTED << endl;
+        return res;
+    }
+    if (!sched)
+        sched.reset(new task_scheduler(threads));
+    if (!stats_ready)
+    {
+        // 第一次增量加入时由全部样本建立充分统计量与基准
+        for (auto &cluster : clusters)
+            rebuild_stats(cluster);
+        refresh_meandis();
+        for (auto &cluster : clusters)
+            cluster.stats.baseline = cluster.innerMeanDis / allMeanDis;
+        stats_ready = true;
+    }
+    const unsigned first = row;
+    // 保留下来的第i个样本在rows中的位置
+    pmr::vector<size_t> pos(&arena);
+    for (size_t r = 0; r < rows.size(); ++r) {
+        auto &line = rows[r];
+        if (line.size() != col)
+        {
+            cout << WARN_DATA_SIZE << endl;
+            continue;
+        }
+        pos.push_back(r);
+        if (compact)
+            fdata.insert(fdata.end(), line.begin(), line.end());
+        else
+            data.emplace_back(std::move(line));
+        if (!weights.empty())
+            weights.push_back(1.0);
+    }
+    row = static_cast<unsigned int>(sample_count());
+    stats_valid = false;
+    if (!compact && mem_budget > 0 && estimate_bytes(row, false) > mem_budget)
+        compact_samples();
+    // 1 并行查找最近中心，再更新充分统计量
+    const unsigned n = row - first;
+    pmr::vector<unsigned> labels(n, &arena);
+    pmr::vector<double> dis(n, &arena);
+    if (metric == METRIC_DIAGONAL)
+        update_inv_var();
+    sched->parallel_for("ingest", n, 1024, [&](size_t begin, size_t end, unsigned) {
+        for (auto i = begin; i < end; ++i) {
+            auto &&r = get_nearest_cluster(static_cast<int>(first + i));
+            labels[i] = static_cast<unsigned>(r.first);
+            // 类内平均距离始终按欧式距离统计
+            dis[i] = metric == METRIC_DIAGONAL ? point_distance(first + i, clusters[r.first]) : r.second;
+        }
+    });
+    pmr::vector<unsigned char> touched(clusters.size(), 0, &arena);
+    for (unsigned i = 0; i < n; ++i) {
+        auto id = first + i;
+        auto &cluster = clusters[labels[i]];
+        auto &st = cluster.stats;
+        auto w = weight(id);
+        cluster.add_point(static_cast<int>(id), w);
+        st.weight += w;
+        st.dissum += w * dis[i];
+        with_row(id, [&](const auto *x) {
+            for (unsigned k = 0; k < col; ++k) {
+                st.sum[k] += w * x[k];
+                st.sumsq[k] += w * x[k] * x[k];
+            }
+        });
+        touched[labels[i]] = 1;
+    }
+    // 2 更新受影响聚类的中心与类内平均距离，其他聚类不变
+    for (unsigned j = 0; j < clusters.size(); ++j) {
+        if (!touched[j])
+            continue;
+        auto &cluster = clusters[j];
+        cluster.center.assign(cluster.stats.sum.begin(), cluster.stats.sum.end());
+        scale_inplace(cluster.center, 1 / cluster.stats.weight);
+        update_norm(cluster);
+        cluster.innerMeanDis = cluster.stats.dissum / cluster.stats.weight;
+    }
+    refresh_meandis();
+    // 3 漂移超过阈值的聚类做局部的分裂与合并检测
+    pmr::vector<unsigned> drifted(&arena);
+    for (unsigned j = 0; j < touched.size(); ++j) {
+        auto &cluster = clusters[j];
+        if (touched[j] && cluster.innerMeanDis / allMeanDis > drift_ratio * cluster.stats.baseline)
+            drifted.push_back(j);
+    }
+    if (!drifted.empty())
+    {
+        const auto k = static_cast<unsigned>(clusters.size());
+        for (auto j : drifted) {
+            // 中心已经增量移动过，先按新中心重新计算距离之和
+            rebuild_stats(clusters[j]);
+            refresh_meandis();
+            if (!local_split(j))
+                continue;
+            // 分裂只把第j个聚类的一部分样本移到末尾的新聚类
+            const auto moved = static_cast<unsigned>(clusters.size() - 1);
+            for (unsigned i = 0; i < n; ++i) {
+                if (labels[i] == j && clusters[moved].ids.count(first + i))
+                    labels[i] = moved;
+            }
+        }
+        for (auto j = k; j < clusters.size(); ++j)
+            drifted.push_back(j);
+        pmr::vector<unsigned> into(&arena);
+        local_merge(drifted, into);
+        // 调整过的聚类以当前状态为新的基准，被合并而留空的聚类统计量为0，不影响总体平均距离
+        refresh_meandis();
+        for (auto j : drifted)
+            clusters[j].stats.baseline = clusters[j].innerMeanDis / allMeanDis;
+        // 删除留空的聚类，编号随之前移
+        pmr::vector<unsigned> shifted(clusters.size(), 0, &arena);
+        unsigned kept(0);
+        for (unsigned j = 0; j < clusters.size(); ++j) {
+            shifted[j] = kept;
+            if (!clusters[j].ids.empty())
+                ++kept;
+        }
+        for (auto &l : labels)
+            l = shifted[into[l]];
+        for (auto it = clusters.begin(); it != clusters.end();) {
+            if (it->ids.empty())
+            {
+                it = clusters.erase(it);
+                stats_valid = false;
+            } else
+                ++it;
+        }
+    }
+    // 4 新样本最终所属的聚类，被丢弃的行为0
+    for (unsigned i = 0; i < n; ++i)
+        res[pos[i]] = static_cast<int32_t>(labels[i] + 1);
+    account_memory();
+    arena.reset();
+    return res;
+}
+
+/**
+ * 每个样本所属聚类的编号，从1开始，0表示不属于任何聚类
+ */
+vector<int32_t> isodata::get_labels() const {
+    vector<int32_t> labels(row, 0);
+    for (int j = 0; j < clusters.size(); ++j) {
+        for (const auto &id : clusters[j].ids) {
+            labels[id] = j + 1;
+        }
+    }
+    return labels;
+}
+
 /**
  * 输出聚类分析的结果
  */
 void isodata::output() const {
+    account_memory();
     // 在命令行窗口打印
-    cout << "Original Data Number : " << row << endl;
-    cout << "Cluster Number : " << clusters.size() << endl;
-    for (int i = 0; i < clusters.size(); ++i) {
-        cout << "Number " << to_string(i+1) << " : " << clusters[i].ids.size() << endl;
-        cout << "cluster center : " << clusters[i].center << endl;
+    if (out_cfg.summary)
+    {
+        cout << "Original Data Number : " << row << '\n';
+        cout << "Cluster Number : " << clusters.size() << '\n';
     }
+    if (out_cfg.print)
+    {
+        for (int i = 0; i < clusters.size(); ++i) {
+            cout << "Number " << to_string(i+1) << " : " << clusters[i].ids.size() << '\n';
+            cout << "cluster center : " << clusters[i].center << '\n';
+        }
+    }
+    cout.flush();
     // 输出到文件
-    ofstream res(R"(E:\CPP\Clion\ISODATA\clusters.txt)");
-    if (!res.is_open())
-        cout << WARN_FILE_OPEN_FAIL << endl;
-    res << clusters.size() << endl;
-    for (int j = 0; j < clusters.size(); ++j) {
-        res << j+1 << " " << clusters[j].ids.size() << endl;
-        for (const auto &id : clusters[j].ids) {
-            res << data[id] << endl;
+    result_writer writer(out_cfg);
+    if (out_cfg.formats & OUT_MEMBERS)
+    {
+        // 每个聚类一行表头，之后是聚类内的样本，负数表示表头
+        vector<long long> items;
+        items.reserve(row + clusters.size());
+        for (int j = 0; j < clusters.size(); ++j) {
+            items.push_back(-(j + 1));
+            for (const auto &id : clusters[j].ids)
+                items.push_back(id);
         }
+        // 输出用的样本序号也计入临时内存
+        mem.set(MEM_SCRATCH, mem.current[MEM_SCRATCH] + items.capacity() * sizeof(long long));
+        writer.write_text(out_cfg.prefix + "clusters.txt", items.size() + 1, [&](size_t begin, size_t end, string &buf) {
+            for (size_t k = begin; k < end; ++k) {
+                if (k == 0)
+                {
+                    result_writer::append(buf, static_cast<long long>(clusters.size()));
+                } else if (items[k - 1] < 0)
+                {
+                    auto j = -items[k - 1] - 1;
+                    result_writer::append(buf, j + 1);
+                    buf.push_back(' ');
+                    result_writer::append(buf, static_cast<long long>(clusters[j].ids.size()));
+                } else if (sparse)
+                {
+                    // 稀疏数据按libsvm格式输出非零元，列号从1开始
+                    auto id = static_cast<unsigned>(items[k - 1]);
+                    for (size_t i = sdata.indptr[id]; i < sdata.indptr[id + 1]; ++i) {
+                        if (i > sdata.indptr[id])
+                            buf.push_back(' ');
+                        result_writer::append(buf, static_cast<long long>(sdata.indices[i]) + 1);
+                        buf.push_back(':');
+                        result_writer::append(buf, sdata.values[i], 6);
+                    }
+                } else
+                {
+                    with_row(static_cast<unsigned>(items[k - 1]), [&](const auto *p) {
+                        for (size_t i = 0; i < col; ++i) {
+                            if (i)
+                                buf.push_back(',');
+                            result_writer::append(buf, static_cast<double>(p[i]), 6);
+                        }
+                    });
+                }
+                buf.push_back('\n');
+            }
+        });
     }
+    if (out_cfg.formats & (OUT_LABELS | OUT_LABELS_BIN))
+    {
+        auto &&labels = get_labels();
+        mem.set(MEM_SCRATCH, mem.current[MEM_SCRATCH] + labels.capacity() * sizeof(int32_t));
+        if (out_cfg.formats & OUT_LABELS)
+            writer.write_labels(out_cfg.prefix + "labels.txt", labels);
+        if (out_cfg.formats & OUT_LABELS_BIN)
+            writer.write_labels_binary(out_cfg.prefix + "labels.bin", labels);
+    }
+    if (out_cfg.formats & OUT_CENTERS)
+    {
+        // 第一行为总体信息，之后每个聚类一行：编号,样本数,类内平均距离,中心各维,标准差各维
+        writer.write_text(out_cfg.prefix + "centers.txt", clusters.size() + 1, [&](size_t begin, size_t end, string &buf) {
+            for (size_t k = begin; k < end; ++k) {
+                if (k == 0)
+                {
+                    buf += "# clusters=";
+                    result_writer::append(buf, static_cast<long long>(clusters.size()));
+                    buf += " rows=";
+                    result_writer::append(buf, static_cast<long long>(row));
+                    buf += " cols=";
+                    result_writer::append(buf, static_cast<long long>(col));
+                    buf += " all_mean_dis=";
+                    result_writer::append(buf, allMeanDis);
+                    buf.push_back('\n');
+                    continue;
+                }
+                auto &cluster = clusters[k - 1];
+                result_writer::append(buf, static_cast<long long>(k));
+                buf.push_back(',');
+                result_writer::append(buf, static_cast<long long>(cluster.ids.size()));
+                buf.push_back(',');
+                result_writer::append(buf, cluster.innerMeanDis);
+                for (auto v : cluster.center) {
+                    buf.push_back(',');
+                    result_writer::append(buf, v);
+                }
+                for (auto v : cluster.sigma) {
+                    buf.push_back(',');
+                    result_writer::append(buf, v);
+                }
+                buf.push_back('\n');
+            }
+        });
+    }
+    account_memory();
 }
 
 
 
 
-
@@ -17,13 +17,32 @@
 #include <deque>
 #include <functional>
 #include "common.h"
+#include "arena.h"
+#include "writer.h"
+#include "reader.h"
+#include "coreset.h"
+#include "sparse.h"
+#include "quant.h"
+#include "numa.h"
+#include "scheduler.h"
+#include <memory>
+#include <memory_resource>
 
 using namespace std;
 // 实现ISODATA聚类算法
 
+/**
+ * 重新分配时使用的距离
+ */
+enum distance_metric {
+    METRIC_EUCLIDEAN, // 欧式距离
+    METRIC_DIAGONAL, // 对角协方差的马氏距离，各维按所属聚类的标准差加权
+};
+
 class isodata {
 private:
     typedef function<vector<vector<double>>(void)> READFUNC;
+    typedef function<csr_matrix(void)> SPARSEFUNC;
     // 直接初始化的数据
     // 为了简单，不预留更改设置的接口，只在初始化时设置
     unsigned _c; // 预期的聚类个数
@@ -37,9 +56,52 @@ private:
     unsigned row; // 数据的行数，也就是样本个数
     unsigned col; // 数据的列数，也就是特征个数
     vector<vector<double>> data; // 待分类的数据
+    vector<double> weights; // 样本的权重，为空时每个样本的权重都是1
+    csr_matrix sdata; // 稀疏的待分类数据，sparse为true时代替data
+    bool sparse; // 是否使用稀疏数据
+    SPARSEFUNC sparse_func; // 读取稀疏数据的函数
+    sq8_store qstore; // 8位量化的样本，只用于重新分配时查找最近中心
+    bool quantized; // 重新分配时是否使用量化样本
+    unsigned long long reranks; // 量化距离无法区分、用原数据复核的次数
+    numa_config numa_cfg; // NUMA设置
+    unique_ptr<numa_assigner> numa; // NUMA感知的并行分配，首次使用时创建
+    bool stats_valid; // 并行分配得到的统计量是否仍与聚类的样本一致，一致时update_centers直接使用
+    unsigned threads; // 任务调度器的线程数，0表示每个CPU一个线程
+    unique_ptr<task_scheduler> sched; // 逐样本、逐聚类阶段的任务调度器，run时创建
+    vector<unsigned char> marks; // 分裂时标记移入新聚类的样本
+    unsigned seed; // 随机数种子
+    bool fixed_seed; // 是否使用固定的种子，否则使用当前时间
+    bool deterministic; // 可复现模式，结果与线程数无关
+    double merge_dis; // 增量模式合并时的中心距离下限，即构造时的_tc(最后一次迭代会把_tc置0)
+    double drift_ratio; // innerMeanDis/allMeanDis 超过基准的这么多倍时触发局部调整
+    bool stats_ready; // 各聚类的充分统计量是否已经建立
+    vector<float> fdata; // 紧凑模式下按行连续存放的float样本，代替data
+    bool compact; // 是否使用紧凑的样本存储
+    const double *view; // 调用者按行连续存放的样本，不为空时代替data，不拷贝
+    size_t mem_budget; // 内存预算，单位字节，0表示不限制
+    bool over_budget; // 紧凑之后仍然超出预算，只警告一次
+    mutable memory_usage mem; // 按类别统计的内存
+    distance_metric metric; // 重新分配使用的距离
+    vector<double> inv_var; // 对角马氏距离各聚类各维的权重，按聚类连续存放
+    vector<unsigned> last_labels; // 上一次重新分配的结果
+    unsigned last_k; // 上一次重新分配时的聚类个数
+    bool labels_changed; // 最近一次重新分配是否有样本改变了所属聚类
+    unsigned last_change; // 最后一次有样本改变所属聚类的迭代，从1开始
+    counting_resource sys_res; // 向系统申请内存的上游，统计申请次数
+    counting_resource id_res; // 样本id集合内存池的上游，单独统计以区分成员关系的内存
+    iter_arena arena; // 单次迭代内的临时数据，每次迭代结束时回收
+    pmr::unsynchronized_pool_resource id_pool; // 聚类中样本id集合的节点内存池
+    vector<unsigned long long> iter_allocs; // 每次迭代中申请内存的次数
     deque<Cluster> clusters; // 聚类
+    double allMeanDis; // 总体平均距离
     READFUNC read_func; // 读取数据的函数，可以自定义
     double alpha; // 分裂系数
+    output_config out_cfg; // 输出设置
+    string async_path; // 异步读取的数据文件，为空时使用read_func
+    size_t async_chunk_rows; // 异步读取时每块的行数
+    size_t seed_rows; // 异步读取时，读到多少行之后开始初始化聚类中心
+    size_t coreset_size; // coreset的抽样次数，0表示不使用coreset
+    unsigned refine_passes; // coreset上聚类结束后，在全部数据上重新分配的次数
 public:
     /**
      * 构造函数
@@ -51,49 +113,346 @@ public:
      * @param _nt 每次迭代中最多可以合并的次数
      * @param _ns 最多迭代次数
      * @param func 读取数据的函数，无输入，返回二维double vector
+     * @param upstream 内存池与arena向其申请内存，多次运行共用一个上游时可以复用内存
      */
     explicit isodata(unsigned int c, unsigned int _nc, unsigned int _tn,
                      double _te, double _tc, unsigned int _nt,
-                     unsigned int _ns, READFUNC func) :
+                     unsigned int _ns, READFUNC func,
+                     pmr::memory_resource *upstream = pmr::new_delete_resource()) :
                      _c(c), _nc(_nc), _tn(_tn),
                      _te(_te), _tc(_tc), _nt(_nt),
                      _ns(_ns), row(0), col(0),
-                     clusters(), read_func(std::move(func)), alpha(0.3) {
+                     sdata(), sparse(false), sparse_func(),
+                     qstore(), quantized(false), reranks(0),
+                     numa_cfg(), numa(), stats_valid(false),
+                     threads(1), sched(), marks(),
+                     seed(0), fixed_seed(false), deterministic(false),
+                     merge_dis(_tc), drift_ratio(1.2), stats_ready(false),
+                     fdata(), compact(false), view(nullptr), mem_budget(0), over_budget(false), mem(),
+                     metric(METRIC_EUCLIDEAN), inv_var(), last_labels(), last_k(0), labels_changed(false), last_change(0),
+                     sys_res(upstream), id_res(upstream), arena(&sys_res), id_pool(&id_res), iter_allocs(),
+                     clusters(), allMeanDis(0), read_func(std::move(func)), alpha(0.3), out_cfg(),
+                     async_path(), async_chunk_rows(4096), seed_rows(0),
+                     coreset_size(0), refine_passes(3) {
     }
+    isodata(const isodata &) = delete;
+    isodata &operator=(const isodata &) = delete;
 
 
 
     void run()
     {
-        setData();
-        init_clusters();
+        bool assigned = false;
+        if (sparse)
+        {
+            setSparseData();
+            init_clusters();
+        } else if (async_path.empty() || view)
+        {
+            setData();
+            init_clusters();
+        } else
+        {
+            // 文件打不开、行宽不一致或样本太少时不运行
+            assigned = ingest_async();
+            if (!assigned)
+                return;
+        }
+        if (!sched)
+            sched.reset(new task_scheduler(threads));
+        vector<vector<double>> full;
+        if (!sparse && !view && coreset_size > 0 && coreset_size < row)
+        {
+            build_coreset(full);
+            assigned = false;
+        }
+        apply_budget(full.size());
+        account_memory();
+        last_labels.clear();
+        last_change = 0;
+        iter_allocs.clear();
+        iter_allocs.reserve(_ns);
         for (int i = 0; i < _ns; ++i) {
-            re_assign();
+            auto allocs = alloc_count();
+            // 异步读取时第一次分配已经随数据到达完成
+            labels_changed = true;
+            if (i > 0 || !assigned)
+                re_assign();
+            if (labels_changed)
+                last_change = static_cast<unsigned>(i + 1);
             check_tn();
             update_centers();
             update_meandis();
             switch_method(i);
+            account_memory();
+            arena.reset();
+            iter_allocs.push_back(alloc_count() - allocs);
         }
+        if (!full.empty())
+            refine(full);
         output();
     }
 
+    /**
+     * 设置输出的格式与路径，缺省只输出clusters.txt
+     */
+    void set_output(const output_config &cfg) { out_cfg = cfg; }
+
+    /**
+     * 改为从文件异步读取数据，读取与初始化、第一次分配重叠进行
+     * @param path 数据文件，格式与read_data相同
+     * @param chunk_rows 每块的行数
+     * @param rows 读到多少行之后用蓄水池样本初始化聚类中心，0表示64*_nc行
+     */
+    void set_async_source(const string &path, size_t chunk_rows = 4096, size_t rows = 0)
+    {
+        async_path = path;
+        async_chunk_rows = chunk_rows;
+        seed_rows = rows;
+    }
+
+    /**
+     * 改为使用稀疏数据，样本以CSR格式保存，聚类中心仍为稠密矢量，
+     * 距离由内积与缓存的范数得到，计算量与非零元个数成正比。稀疏数据不支持异步读取与coreset
+     * @param func 读取稀疏数据的函数，例如绑定了路径的read_libsvm
+     */
+    void set_sparse_source(SPARSEFUNC func)
+    {
+        sparse_func = std::move(func);
+        sparse = true;
+    }
+
+    /**
+     * 直接使用调用者按行连续存放的rows×cols个样本，不拷贝也不调用读取函数，用于batch_runner；
+     * 这块内存在run()与之后读取结果的期间必须保持有效。不支持异步读取、coreset、内存预算、
+     * NUMA分配、量化分配与ingest
+     */
+    void set_rows(const double *values, unsigned rows, unsigned cols)
+    {
+        view = values;
+        row = rows;
+        col = cols;
+    }
+
+    /**
+     * 重新分配时在8位量化的样本上查找最近中心，内存访问量约为原来的1/8；
+     * 最近的两个中心的量化距离之差在误差范围内时用原数据复核，因此分配结果与不量化时相同。
+     * 更新中心、标准差等仍使用原数据。稀疏数据不使用量化
+     */
+    void set_quantized(bool on) { quantized = on; }
+
+    /**
+     * 重新分配改为NUMA感知的多线程执行：样本分片放在各节点本地，线程绑定到分片所在节点，
+     * 统计量按线程、节点逐级汇总。单节点机器上自动退化为普通的多线程分配。
+     * 优先于量化分配；稀疏数据不使用
+     */
+    void set_numa(const numa_config &cfg)
+    {
+        numa_cfg = cfg;
+        numa.reset();
+    }
+
+    /**
+     * 设置任务调度器的线程数，缺省为1。
+     * 重新分配、更新中心、标准差、平均距离与分裂都由调度器并行执行，
+     * 逐聚类的阶段按哈希桶把大聚类切成多片，部分结果按片的顺序汇总
+     * @param n 线程数，0表示每个CPU一个线程
+     */
+    void set_threads(unsigned n)
+    {
+        threads = n;
+        sched.reset();
+    }
+
+    /**
+     * 固定初始化聚类中心、异步读取时的蓄水池抽样与coreset抽样使用的随机数种子，
+     * 缺省使用当前时间
+     */
+    void set_seed(unsigned s)
+    {
+        seed = s;
+        fixed_seed = true;
+    }
+
+    /**
+     * 可复现模式：没有设置种子时使用固定的种子0，
+     * NUMA分配的统计量按固定的行块累加、按固定的顺序两两求和，
+     * 从而在任意线程数下输出逐位相同。
+     * 调度器执行的阶段按与线程数无关的片汇总，本来就不受线程数影响
+     */
+    void set_deterministic(bool on)
+    {
+        deterministic = on;
+        numa.reset();
+    }
+
+    /**
+     * 增量加入新样本，需在run()之后调用，稀疏数据与set_rows给出的样本不支持
+     * 新样本分配到最近的聚类，并更新这些聚类的充分统计量、中心与类内平均距离；
+     * 类内平均距离与总体平均距离之比超过基准的drift_ratio倍的聚类，
+     * 只对它们做一次分裂与合并的检测。耗时与新样本数成正比，与已有样本数无关
+     * @param rows 新样本
+     * @return 每个新样本所属聚类的编号，从1开始，0表示被丢弃
+     */
+    vector<int32_t> ingest(vector<vector<double>> rows);
+
+    /**
+     * 设置触发局部调整的漂移倍数，缺省为1.2
+     */
+    void set_drift(double ratio) { drift_ratio = ratio; }
+
+    /**
+     * 按输出设置重新输出当前的聚类结果，用于增量加入样本之后
+     */
+    void write_results() const { output(); }
+
+    /**
+     * 设置内存预算。样本按double存储估计会超出预算时改为按行连续的float存储，
+     * 异步读取时一旦超出就在读取过程中转换，之后到达的样本直接以float保存；
+     * 紧凑存储不使用NUMA分配与量化分配。转换之后仍超出预算时给出警告并继续运行。
+     * 预算只限制读入之后的内存，不限制读取时的峰值：同步读取时读取函数返回的样本全是double，
+     * 读完才转换，转换期间两份同时存在；使用coreset时全部数据要按double保留给refine，不转换，
+     * 超出时只给出警告。需要限制读取峰值时使用set_async_source
+     * @param bytes 字节数，0表示不限制
+     */
+    void set_memory_budget(size_t bytes) { mem_budget = bytes; }
+
+    /**
+     * 设置重新分配使用的距离，缺省为欧式距离
+     * METRIC_DIAGONAL 按各聚类各维的方差加权，适合各维尺度不同、形状拉长的聚类；
+     * 权重每次迭代由标准差重新计算，每个聚类的权重之积为1，距离与欧式距离同量级。
+     * 只影响样本分到哪个聚类，平均距离、分裂与合并仍按欧式距离判断。
+     * 稀疏数据不支持；使用时不走NUMA分配与量化分配
+     */
+    void set_metric(distance_metric m) { metric = m; }
+
+    /**
+     * 最近一次run()中最后一次有样本改变所属聚类的迭代，从1开始；
+     * 小于最多迭代次数时，之后的迭代分配结果不再变化
+     */
+    unsigned iterations_to_converge() const { return last_change; }
+
+    /**
+     * 按类别统计的内存字节数与峰值，在载入数据、每次迭代结束与输出时更新
+     */
+    const memory_usage &memory() const { return mem; }
+
+    /**
+     * 样本是否已改为紧凑存储
+     */
+    bool is_compact() const { return compact; }
+
+    /**
+     * 聚类结果：各聚类，每个样本所属聚类的编号(从1开始)，总体平均距离
+     */
+    const deque<Cluster> &get_clusters() const { return clusters; }
+    vector<int32_t> labels() const { return get_labels(); }
+    double mean_distance() const { return allMeanDis; }
+
+    /**
+     * 各阶段累计的耗时，包括各线程的空闲时间
+     */
+    const map<string, phase_timing> &phase_timings() const
+    {
+        static const map<string, phase_timing> none;
+        return sched ? sched->timings() : none;
+    }
+
+    /**
+     * 量化分配中用原数据复核的次数
+     */
+    unsigned long long quantized_reranks() const { return reranks; }
+
+    /**
+     * 使用coreset近似聚类：在加权的coreset上完成分裂/合并的迭代，
+     * 再在全部数据上做若干次重新分配与中心更新
+     * @param m coreset的抽样次数，0表示关闭
+     * @param passes 在全部数据上重新分配的次数
+     */
+    void set_coreset(size_t m, unsigned passes = 3)
+    {
+        coreset_size = m;
+        refine_passes = passes;
+    }
+
+    /**
+     * 每次迭代中申请内存的次数，稳定之后(没有分裂、合并时)应当为0
+     * 计数构建(链接alloc_count.cpp)中统计全局operator new的全部调用，
+     * 否则只统计经过内存池与arena上游的申请
+     */
+    const vector<unsigned long long> &iteration_allocs() const { return iter_allocs; }
+    unsigned long long last_iteration_allocs() const { return iter_allocs.empty() ? 0 : iter_allocs.back(); }
+
 private:
     void setData();
+    void setSparseData();
+    double point_distance(unsigned id, const Cluster &cluster) const;
+    double assign_distance(unsigned id, unsigned j) const;
+    void update_inv_var();
+    void track_labels(const unsigned *labels);
+    bool same_point(unsigned a, unsigned b) const;
+    vector<double> dense_point(unsigned id) const;
+    void update_norm(Cluster &cluster) const;
+    unsigned rand_seed() const;
+    unsigned long long alloc_count() const
+    {
+        return heap_counting ? heap_allocs.load() : sys_res.count() + id_res.count();
+    }
+    /**
+     * 以样本第一个元素的指针调用f，紧凑存储时为float，否则为double
+     */
+    template <typename F>
+    void with_row(unsigned id, F f) const
+    {
+        if (compact)
+            f(fdata.data() + static_cast<size_t>(id) * col);
+        else if (view)
+            f(view + static_cast<size_t>(id) * col);
+        else
+            f(data[id].data());
+    }
+    size_t sample_count() const { return compact ? fdata.size() / col : view ? row : data.size(); }
+    size_t estimate_bytes(size_t rows, bool flat) const;
+    void compact_samples();
+    void apply_budget(size_t held_rows = 0);
+    void account_memory() const;
     void init_clusters();
-    pair<int, double> get_nearest_cluster(int p_index, int ignore);
-    pair<int, double> get_nearest_cluster(int p_index, unordered_set<unsigned>&);
+    bool seed_from(vector<unsigned> &candidates, std::default_random_engine &rand);
+    bool ingest_async();
+    pair<int, double> get_nearest_cluster(int p_index, int ignore = -1);
+    pair<int, double> get_nearest_cluster(int p_index, const pmr::unordered_set<unsigned>&);
+    void build_coreset(vector<vector<double>> &full);
+    void refine(vector<vector<double>> &full);
+    double weight(unsigned id) const { return weights.empty() ? 1.0 : weights[id]; }
+    double mass(const Cluster &cluster) const;
     void re_assign();
+    void re_assign_quantized();
+    void re_assign_numa();
     void check_tn();
+    /**
+     * 聚类的一片：ids中[b0, b1)号桶内的样本
+     */
+    struct piece {
+        const Cluster *cluster;
+        size_t b0, b1;
+        unsigned slot; // 聚类在列表中的序号
+    };
+    void make_pieces(Cluster *const *list, size_t k, pmr::vector<piece> &out) const;
     void update_centers();
-    void update_center(Cluster& cluster);
+    void update_centers(Cluster *const *list, size_t k);
     void update_sigmas();
-    void update_sigma(Cluster& cluster);
+    void update_sigmas(Cluster *const *list, size_t k);
     void update_meandis();
     void check_split();
-    void split(const int& c_index);
+    bool split(const int& c_index);
     void check_merge();
     void merge(const int& id1, const int& id2);
     void switch_method(const int& index);
+    void rebuild_stats(Cluster &cluster);
+    void refresh_meandis();
+    bool local_split(unsigned j);
+    unsigned local_merge(const pmr::vector<unsigned> &which, pmr::vector<unsigned> &into);
+    vector<int32_t> get_labels() const;
     void output() const;
 };
 
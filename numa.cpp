@@ -0,0 +1,336 @@
+//
+// Created by Jeff on 2019/1/27 0027.
+//
+
+#include "numa.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * 解析形如"0-3,8,10-11"的CPU或节点列表
+ */
+static vector<unsigned> parse_cpulist(const string &s)
+{
+    vector<unsigned> res;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        if (item.empty() || item[0] == '\n')
+            continue;
+        auto dash = item.find('-');
+        auto a = static_cast<unsigned>(stoul(item.substr(0, dash)));
+        auto b = dash == string::npos ? a : static_cast<unsigned>(stoul(item.substr(dash + 1)));
+        for (auto c = a; c <= b; ++c)
+            res.push_back(c);
+    }
+    return res;
+}
+
+/**
+ * 本进程可以使用的CPU
+ */
+static vector<unsigned> allowed_cpus()
+{
+    vector<unsigned> res;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (unsigned c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &set))
+                res.push_back(c);
+        }
+    }
+#endif
+    if (res.empty())
+    {
+        auto n = max(thread::hardware_concurrency(), 1u);
+        for (unsigned c = 0; c < n; ++c)
+            res.push_back(c);
+    }
+    return res;
+}
+
+/**
+ * 读取NUMA拓扑，只保留本进程可以使用的CPU
+ * 没有/sys/devices/system/node(非Linux或者内核不支持)时，退化为包含全部CPU的一个节点
+ * @param simulate_nodes 大于0时忽略真实拓扑，把可用CPU平均分成这么多个虚拟节点
+ */
+vector<numa_node> numa_topology(unsigned simulate_nodes)
+{
+    auto cpus = allowed_cpus();
+    vector<numa_node> nodes;
+    if (simulate_nodes > 0)
+    {
+        for (unsigned n = 0; n < simulate_nodes; ++n) {
+            numa_node node{n, {}};
+            for (size_t i = n; i < cpus.size(); i += simulate_nodes)
+                node.cpus.push_back(cpus[i]);
+            // CPU比节点少时，多个虚拟节点共用CPU
+            if (node.cpus.empty())
+                node.cpus.push_back(cpus[n % cpus.size()]);
+            nodes.push_back(node);
+        }
+        return nodes;
+    }
+    ifstream online("/sys/devices/system/node/online");
+    string ids;
+    if (online.is_open() && getline(online, ids))
+    {
+        for (auto n : parse_cpulist(ids)) {
+            ifstream f("/sys/devices/system/node/node" + to_string(n) + "/cpulist");
+            string s;
+            if (!f.is_open() || !getline(f, s))
+                continue;
+            numa_node node{n, {}};
+            for (auto c : parse_cpulist(s)) {
+                if (find(cpus.begin(), cpus.end(), c) != cpus.end())
+                    node.cpus.push_back(c);
+            }
+            if (!node.cpus.empty())
+                nodes.push_back(node);
+        }
+    }
+    if (nodes.empty())
+        nodes.push_back(numa_node{0, cpus});
+    return nodes;
+}
+
+/**
+ * 把当前线程绑定到一个CPU上，不支持时返回false
+ */
+bool pin_thread(unsigned cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+numa_pool::numa_pool(const numa_config &cfg) :
+        workers(), wnode(), nnodes(0), job(nullptr), gen(0), pending(0), quit(false) {
+    auto topo = numa_topology(cfg.simulate_nodes);
+    nnodes = static_cast<unsigned>(topo.size());
+    size_t ncpu(0);
+    for (auto &node : topo)
+        ncpu += node.cpus.size();
+    unsigned n = cfg.threads ? cfg.threads : static_cast<unsigned>(ncpu);
+    n = max(n, nnodes);
+    // 线程按节点轮流分配，第w个线程位于第w % nnodes个节点，因此前nnodes个线程是各节点的代表
+    vector<int> cpu(n);
+    for (unsigned w = 0; w < n; ++w) {
+        auto &node = topo[w % nnodes];
+        wnode.push_back(w % nnodes);
+        cpu[w] = cfg.pin ? static_cast<int>(node.cpus[(w / nnodes) % node.cpus.size()]) : -1;
+    }
+    for (unsigned w = 0; w < n; ++w)
+        workers.emplace_back(&numa_pool::loop, this, w, cpu[w]);
+}
+
+numa_pool::~numa_pool() {
+    {
+        lock_guard<mutex> lk(m);
+        quit = true;
+    }
+    cv.notify_all();
+    for (auto &t : workers)
+        t.join();
+}
+
+/**
+ * 每个线程执行一次job(线程序号)，全部完成后返回
+ */
+void numa_pool::run(const function<void(unsigned)> &f) {
+    unique_lock<mutex> lk(m);
+    job = &f;
+    pending = size();
+    ++gen;
+    cv.notify_all();
+    done_cv.wait(lk, [this] { return pending == 0; });
+    job = nullptr;
+}
+
+void numa_pool::loop(unsigned w, int cpu) {
+    // 绑定失败(例如CPU被cgroup限制)时不绑定继续运行
+    if (cpu >= 0)
+        pin_thread(static_cast<unsigned>(cpu));
+    unsigned long long seen = 0;
+    while (true)
+    {
+        const function<void(unsigned)> *f;
+        {
+            unique_lock<mutex> lk(m);
+            cv.wait(lk, [&] { return quit || gen != seen; });
+            if (quit)
+                return;
+            seen = gen;
+            f = job;
+        }
+        (*f)(w);
+        {
+            lock_guard<mutex> lk(m);
+            if (--pending == 0)
+                done_cv.notify_one();
+        }
+    }
+}
+
+// 确定性模式下的行块大小，分片边界与行块对齐
+static const unsigned block_rows = 4096;
+
+numa_assigner::numa_assigner(const numa_config &cfg) :
+        pool(cfg), nrow(0), ncol(0), src(nullptr), shards(), node_centers(), node_stats(), label(), total(),
+        deterministic(false), block_stats() {
+}
+
+/**
+ * 对base[0], base[stride], ... 中[b0, b1)项两两求和，求和的顺序只取决于项数
+ */
+static double pairwise_sum(const double *base, size_t stride, size_t b0, size_t b1)
+{
+    if (b1 - b0 == 1)
+        return base[b0 * stride];
+    auto mid = b0 + (b1 - b0) / 2;
+    return pairwise_sum(base, stride, b0, mid) + pairwise_sum(base, stride, mid, b1);
+}
+
+/**
+ * 切分数据，由各分片所在节点上的线程拷贝自己的分片
+ */
+void numa_assigner::place(const vector<vector<double>> &data, const vector<double> &weights) {
+    nrow = static_cast<unsigned>(data.size());
+    ncol = nrow ? static_cast<unsigned>(data[0].size()) : 0;
+    src = data.data();
+    auto n = pool.size();
+    shards.assign(n, shard());
+    // 确定性模式下按行块切分，每个行块完整地属于一个分片
+    const unsigned long long unit = deterministic ? block_rows : 1;
+    const unsigned long long units = (nrow + unit - 1) / unit;
+    for (unsigned w = 0; w < n; ++w) {
+        shards[w].begin = static_cast<unsigned>(min(units * w / n * unit, static_cast<unsigned long long>(nrow)));
+        shards[w].end = static_cast<unsigned>(min(units * (w + 1) / n * unit, static_cast<unsigned long long>(nrow)));
+    }
+    label.assign(nrow, 0);
+    node_centers.assign(pool.nodes(), vector<double>());
+    node_stats.assign(pool.nodes(), vector<double>());
+    pool.run([&](unsigned w) {
+        auto &s = shards[w];
+        s.rows.resize(static_cast<size_t>(s.end - s.begin) * ncol);
+        auto p = s.rows.data();
+        for (auto r = s.begin; r < s.end; ++r, p += ncol)
+            copy(data[r].begin(), data[r].end(), p);
+        if (!weights.empty())
+            s.weights.assign(weights.begin() + s.begin, weights.begin() + s.end);
+    });
+}
+
+/**
+ * 分配全部样本到最近的聚类中心，同时计算统计量
+ * @param centers 按行连续存放的k个聚类中心
+ */
+void numa_assigner::assign(const double *centers, unsigned k) {
+    const size_t width = 1 + static_cast<size_t>(ncol);
+    // 1 每个节点的代表线程在本节点上保存一份聚类中心
+    pool.run([&](unsigned w) {
+        if (!pool.leader(w))
+            return;
+        node_centers[w].assign(centers, centers + static_cast<size_t>(k) * ncol);
+    });
+    // 2 各线程分配自己的分片，统计量累加到线程内，确定性模式下累加到所在的行块
+    const size_t nblocks = (nrow + block_rows - 1) / block_rows;
+    if (deterministic)
+        block_stats.assign(nblocks * k * width, 0);
+    pool.run([&](unsigned w) {
+        auto &s = shards[w];
+        auto &c = node_centers[pool.node_of(w)];
+        s.partial.assign(deterministic ? 0 : k * width, 0);
+        const double *p = s.rows.data();
+        for (auto r = s.begin; r < s.end; ++r, p += ncol) {
+            unsigned best = 0;
+            double dis = 0;
+            for (unsigned j = 0; j < k; ++j) {
+                const double *cj = c.data() + static_cast<size_t>(j) * ncol;
+                double d(0);
+                for (unsigned i = 0; i < ncol; ++i)
+                    d += (p[i] - cj[i]) * (p[i] - cj[i]);
+                if (j == 0 || d < dis)
+                {
+                    dis = d;
+                    best = j;
+                }
+            }
+            label[r] = best;
+            double wt = s.weights.empty() ? 1.0 : s.weights[r - s.begin];
+            double *acc = deterministic ? block_stats.data() + (r / block_rows * k + best) * width
+                                        : s.partial.data() + best * width;
+            acc[0] += wt;
+            for (unsigned i = 0; i < ncol; ++i)
+                acc[1 + i] += wt * p[i];
+        }
+    });
+    if (deterministic)
+    {
+        reduce_blocks(k);
+        return;
+    }
+    // 3 节点内汇总
+    pool.run([&](unsigned w) {
+        if (!pool.leader(w))
+            return;
+        auto &ns = node_stats[w];
+        ns.assign(k * width, 0);
+        for (unsigned v = w; v < pool.size(); v += pool.nodes()) {
+            for (size_t i = 0; i < ns.size(); ++i)
+                ns[i] += shards[v].partial[i];
+        }
+    });
+    // 4 跨节点汇总
+    total.assign(k * width, 0);
+    for (auto &ns : node_stats) {
+        for (size_t i = 0; i < total.size(); ++i)
+            total[i] += ns[i];
+    }
+}
+
+/**
+ * 确定性模式的汇总：各线程负责统计量的一段，对每一项按行块两两求和
+ * 行块与求和顺序都与线程数无关，因此结果逐位相同
+ */
+void numa_assigner::reduce_blocks(unsigned k) {
+    const size_t len = k * (1 + static_cast<size_t>(ncol));
+    const size_t nblocks = (nrow + block_rows - 1) / block_rows;
+    total.assign(len, 0);
+    if (nblocks == 0)
+        return;
+    pool.run([&](unsigned w) {
+        auto b = len * w / pool.size(), e = len * (w + 1) / pool.size();
+        for (auto i = b; i < e; ++i)
+            total[i] = pairwise_sum(block_stats.data() + i, len, 0, nblocks);
+    });
+}
+
+/**
+ * 占用的内存字节数，主要是各分片的样本副本
+ */
+size_t numa_assigner::bytes() const {
+    size_t res = label.capacity() * sizeof(unsigned) + (total.capacity() + block_stats.capacity()) * sizeof(double);
+    for (auto &s : shards)
+        res += (s.rows.capacity() + s.weights.capacity() + s.partial.capacity()) * sizeof(double);
+    for (auto &c : node_centers)
+        res += c.capacity() * sizeof(double);
+    for (auto &c : node_stats)
+        res += c.capacity() * sizeof(double);
+    return res;
+}
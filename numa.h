@@ -0,0 +1,119 @@
+//
+// Created by Jeff on 2019/1/27 0027.
+//
+
+#ifndef ISODATA_NUMA_H
+#define ISODATA_NUMA_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+/**
+ * NUMA设置
+ */
+struct numa_config {
+    bool enabled; // 是否使用NUMA感知的并行分配
+    unsigned threads; // 工作线程数，0表示每个可用CPU一个线程
+    bool pin; // 是否把工作线程绑定到所在节点的CPU上
+    unsigned simulate_nodes; // 大于0时把可用CPU平均分成这么多个虚拟节点，用于在单节点机器上测试
+    numa_config() : enabled(false), threads(0), pin(true), simulate_nodes(0) {}
+};
+
+/**
+ * 一个NUMA节点及其上可用的CPU
+ */
+struct numa_node {
+    unsigned id;
+    vector<unsigned> cpus;
+};
+
+vector<numa_node> numa_topology(unsigned simulate_nodes = 0);
+bool pin_thread(unsigned cpu);
+
+/**
+ * 常驻的工作线程池，线程按节点轮流分配并绑定到节点内的CPU
+ * run()让每个线程执行一次同一个任务，全部完成后返回
+ */
+class numa_pool {
+public:
+    explicit numa_pool(const numa_config &cfg);
+    numa_pool(const numa_pool &) = delete;
+    numa_pool &operator=(const numa_pool &) = delete;
+    ~numa_pool();
+    unsigned size() const { return static_cast<unsigned>(wnode.size()); }
+    unsigned nodes() const { return nnodes; }
+    unsigned node_of(unsigned w) const { return wnode[w]; }
+    bool leader(unsigned w) const { return w < nnodes; }
+    void run(const function<void(unsigned)> &job);
+    /**
+     * 以引用包装job，避免构造function时申请堆内存
+     */
+    template <typename F>
+    void run(const F &job)
+    {
+        run(function<void(unsigned)>(std::cref(job)));
+    }
+
+private:
+    void loop(unsigned w, int cpu);
+
+    vector<thread> workers;
+    vector<unsigned> wnode; // 每个线程所在的节点
+    unsigned nnodes; // 节点个数
+    mutex m;
+    condition_variable cv; // 通知有新任务
+    condition_variable done_cv; // 通知任务完成
+    const function<void(unsigned)> *job;
+    unsigned long long gen; // 任务的代数
+    unsigned pending; // 未完成的线程数
+    bool quit;
+};
+
+/**
+ * NUMA感知的重新分配
+ * 样本按行切成与线程数相同的分片，每个分片由绑定在某个节点上的线程首次写入(first-touch)，
+ * 从而分配在该节点的内存上；聚类中心在每个节点上各保存一份；
+ * 每个线程只读本节点的数据，统计量先在线程内累加，再按节点汇总，最后跨节点汇总
+ */
+class numa_assigner {
+public:
+    explicit numa_assigner(const numa_config &cfg);
+    void set_deterministic(bool on) { deterministic = on; }
+    void place(const vector<vector<double>> &data, const vector<double> &weights);
+    const void *source() const { return src; }
+    unsigned rows() const { return nrow; }
+    unsigned nodes() const { return pool.nodes(); }
+    void assign(const double *centers, unsigned k);
+    const vector<unsigned> &labels() const { return label; }
+    const vector<double> &stats() const { return total; }
+    size_t bytes() const;
+
+private:
+    void reduce_blocks(unsigned k);
+
+    struct shard {
+        unsigned begin, end; // 负责的行[begin, end)
+        vector<double> rows; // 按行连续存放的样本，在所在节点上分配
+        vector<double> weights; // 样本的权重，为空表示都是1
+        vector<double> partial; // 本线程的统计量
+    };
+    numa_pool pool;
+    unsigned nrow;
+    unsigned ncol;
+    const void *src; // 分片时数据的地址，用于判断数据是否已被替换
+    vector<shard> shards;
+    vector<vector<double>> node_centers; // 每个节点上的一份聚类中心
+    vector<vector<double>> node_stats; // 每个节点汇总的统计量
+    vector<unsigned> label; // 每个样本所属的聚类
+    vector<double> total; // 全部统计量，每个聚类 1+ncol 个：权重和、各维的加权和
+    bool deterministic; // 是否按固定的行块与固定的顺序汇总，使结果与线程数无关
+    vector<double> block_stats; // 确定性模式下每个行块的统计量
+};
+
+
+#endif //ISODATA_NUMA_H
@@ -0,0 +1,81 @@
+//
+// Created by Jeff on 2019/1/20 0020.
+//
+
+#include "protocol.h"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cerrno>
+
+/**
+ * 写满n个字节，处理被信号打断与部分写入的情况
+ * 对端进程退出时send返回EPIPE而不是产生SIGPIPE，由调用者按通信失败处理
+ */
+static bool write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        auto w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+/**
+ * 读满n个字节，对端关闭时返回false
+ */
+static bool read_all(int fd, char *p, size_t n)
+{
+    while (n > 0)
+    {
+        auto r = read(fd, p, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+/**
+ * 发送一条消息
+ * @param fd 套接字
+ * @param type 消息类型
+ * @param payload 负载
+ * @return 是否成功
+ */
+bool send_msg(int fd, uint32_t type, const msg_buffer &payload)
+{
+    if (payload.buf.size() > MAX_PAYLOAD)
+        return false;
+    msg_header h{type, 0, payload.buf.size()};
+    return write_all(fd, reinterpret_cast<const char *>(&h), sizeof(h)) &&
+           write_all(fd, payload.buf.data(), payload.buf.size());
+}
+
+/**
+ * 接收一条消息，负载的读位置重置到开头
+ * @param fd 套接字
+ * @param type 消息类型
+ * @param payload 负载
+ * @return 是否成功，负载长度超过MAX_PAYLOAD时失败
+ */
+bool recv_msg(int fd, uint32_t &type, msg_buffer &payload)
+{
+    msg_header h{};
+    if (!read_all(fd, reinterpret_cast<char *>(&h), sizeof(h)))
+        return false;
+    if (h.size > MAX_PAYLOAD)
+        return false;
+    type = h.type;
+    payload.buf.resize(h.size);
+    payload.pos = 0;
+    return read_all(fd, payload.buf.data(), h.size);
+}
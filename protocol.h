@@ -0,0 +1,96 @@
+//
+// Created by Jeff on 2019/1/20 0020.
+//
+
+#ifndef ISODATA_PROTOCOL_H
+#define ISODATA_PROTOCOL_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+// 协调进程与分片进程之间的二进制协议
+// 每条消息由定长的消息头和紧随其后的负载组成，负载按本机字节序直接存放，
+// 所有进程运行在同一台机器上，因此不做字节序转换
+enum msg_type : uint32_t {
+    MSG_HELLO = 1,  // 分片 -> 协调：本分片的行数、列数
+    MSG_SEED,       // 协调 -> 分片：请求若干随机样本用于初始化聚类中心
+    MSG_ASSIGN,     // 协调 -> 分片：下发聚类中心并重新分配，返回统计量
+    MSG_STATS,      // 协调 -> 分片：按当前分配返回统计量
+    MSG_MEANDIS,    // 协调 -> 分片：下发聚类中心，返回各聚类的距离和
+    MSG_MOVE,       // 协调 -> 分片：将某个聚类的样本移到未被排除的最近聚类，返回各聚类样本数
+    MSG_SPLIT,      // 协调 -> 分片：分裂某个聚类，返回分裂后两个聚类的统计量
+    MSG_RELABEL,    // 协调 -> 分片：聚类编号重映射
+    MSG_QUIT,       // 协调 -> 分片：退出
+    MSG_REPLY       // 分片 -> 协调：应答
+};
+
+struct msg_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t size; // 负载的字节数
+};
+
+// 单条消息负载的上限，超过时按损坏的消息处理，避免按错误的长度申请内存
+const uint64_t MAX_PAYLOAD = 1ull << 30;
+
+/**
+ * 消息负载的读写缓冲
+ * 读取越界时不读取任何内容，输出置0，缓冲进入失败状态，之后的读取都失败；
+ * 读完一条消息后由调用者检查good()
+ */
+class msg_buffer {
+public:
+    msg_buffer() : buf(), pos(0) {}
+    template <typename T>
+    void put(const T &v)
+    {
+        auto old = buf.size();
+        buf.resize(old + sizeof(T));
+        memcpy(buf.data() + old, &v, sizeof(T));
+    }
+    template <typename T>
+    void put(const T *p, size_t n)
+    {
+        auto old = buf.size();
+        buf.resize(old + n * sizeof(T));
+        if (n)
+            memcpy(buf.data() + old, p, n * sizeof(T));
+    }
+    template <typename T>
+    T get()
+    {
+        T v{};
+        get(&v, 1);
+        return v;
+    }
+    template <typename T>
+    void get(T *p, size_t n)
+    {
+        if (n > left() / sizeof(T))
+        {
+            if (n)
+                memset(p, 0, n * sizeof(T));
+            fail();
+            return;
+        }
+        if (n)
+            memcpy(p, buf.data() + pos, n * sizeof(T));
+        pos += n * sizeof(T);
+    }
+    bool good() const { return pos <= buf.size(); }
+    size_t left() const { return good() ? buf.size() - pos : 0; } // 剩余未读的字节数
+    void fail() { pos = buf.size() + 1; }
+    void clear() { buf.clear(); pos = 0; }
+    vector<char> buf;
+    size_t pos;
+};
+
+bool send_msg(int fd, uint32_t type, const msg_buffer &payload);
+bool recv_msg(int fd, uint32_t &type, msg_buffer &payload);
+
+
+#endif //ISODATA_PROTOCOL_H
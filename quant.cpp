@@ -0,0 +1,78 @@
+//
+// Created by Jeff on 2019/1/26 0026.
+//
+
+#include "quant.h"
+#include <cmath>
+#include <algorithm>
+
+/**
+ * 量化全部样本
+ */
+void sq8_store::build(const vector<vector<double>> &data) {
+    nrow = static_cast<unsigned>(data.size());
+    ncol = nrow ? static_cast<unsigned>(data[0].size()) : 0;
+    src = data.data();
+    lo.assign(ncol, 0);
+    step.assign(ncol, 0);
+    w.assign(ncol, 0);
+    vector<double> hi(ncol, 0);
+    for (unsigned r = 0; r < nrow; ++r) {
+        for (unsigned i = 0; i < ncol; ++i) {
+            if (r == 0 || data[r][i] < lo[i])
+                lo[i] = data[r][i];
+            if (r == 0 || data[r][i] > hi[i])
+                hi[i] = data[r][i];
+        }
+    }
+    double e(0);
+    for (unsigned i = 0; i < ncol; ++i) {
+        step[i] = (hi[i] - lo[i]) / 255;
+        w[i] = static_cast<float>(step[i] * step[i]);
+        e += step[i] * step[i] / 4;
+    }
+    // 中心编码与float累加的舍入也计入误差
+    err = sqrt(e) * (1 + 1e-5) + 1e-9;
+    codes.resize(static_cast<size_t>(nrow) * ncol);
+    errs.resize(nrow);
+    for (unsigned r = 0; r < nrow; ++r) {
+        auto out = codes.data() + static_cast<size_t>(r) * ncol;
+        double re(0);
+        for (unsigned i = 0; i < ncol; ++i) {
+            double q = step[i] > 0 ? (data[r][i] - lo[i]) / step[i] : 0;
+            out[i] = static_cast<uint8_t>(min(max(lround(q), 0L), 255L));
+            double d = lo[i] + step[i] * out[i] - data[r][i];
+            re += d * d;
+        }
+        errs[r] = nextafter(static_cast<float>(sqrt(re)), HUGE_VALF);
+    }
+}
+
+/**
+ * 把聚类中心变换到量化空间：q = (c - lo) / step，不截断到0~255
+ */
+void sq8_store::encode_center(const vector<double> &center, float *out) const {
+    for (unsigned i = 0; i < ncol; ++i)
+        out[i] = step[i] > 0 ? static_cast<float>((center[i] - lo[i]) / step[i]) : 0.f;
+}
+
+/**
+ * 量化样本与中心的距离平方 sum(step^2 * (code - q)^2)
+ */
+float sq8_store::distance2(unsigned r, const float *qc) const {
+    const uint8_t *p = code(r);
+    float res(0);
+    for (unsigned i = 0; i < ncol; ++i) {
+        float d = static_cast<float>(p[i]) - qc[i];
+        res += w[i] * d * d;
+    }
+    return res;
+}
+
+/**
+ * 占用的内存字节数
+ */
+size_t sq8_store::bytes() const {
+    return codes.capacity() + errs.capacity() * sizeof(float) + w.capacity() * sizeof(float)
+           + (lo.capacity() + step.capacity()) * sizeof(double);
+}
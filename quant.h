@@ -0,0 +1,45 @@
+//
+// Created by Jeff on 2019/1/26 0026.
+//
+
+#ifndef ISODATA_QUANT_H
+#define ISODATA_QUANT_H
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * 按维度标量量化为8位的样本
+ * 每一维独立地把[lo, hi]均匀量化到0~255，x ≈ lo + step * code，
+ * 每个样本量化前后的距离记录在row_error中，据此判断最近中心是否需要用原数据复核
+ */
+class sq8_store {
+public:
+    sq8_store() : nrow(0), ncol(0), err(0), src(nullptr) {}
+    void build(const vector<vector<double>> &data);
+    unsigned rows() const { return nrow; }
+    unsigned cols() const { return ncol; }
+    const void *source() const { return src; }
+    size_t bytes() const;
+    double max_error() const { return err; }
+    double row_error(unsigned r) const { return errs[r]; }
+    const uint8_t *code(unsigned r) const { return codes.data() + static_cast<size_t>(r) * ncol; }
+    void encode_center(const vector<double> &center, float *out) const;
+    float distance2(unsigned r, const float *qc) const;
+
+private:
+    unsigned nrow;
+    unsigned ncol;
+    vector<double> lo; // 每一维的最小值
+    vector<double> step; // 每一维的量化步长
+    vector<float> w; // 每一维的步长平方，量化空间中距离的权重
+    vector<uint8_t> codes; // 按行连续存放的量化值
+    vector<float> errs; // 每个样本量化前后的距离(向上取整到float)
+    double err; // 全部样本量化误差的上界
+    const void *src; // 量化时数据的地址，用于判断数据是否已被替换
+};
+
+
+#endif //ISODATA_QUANT_H
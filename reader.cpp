@@ -0,0 +1,135 @@
+//
+// Created by Jeff on 2019/1/23 0023.
+//
+
+#include "reader.h"
+#include "error.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+chunk_reader::chunk_reader(string path, size_t chunk_rows, size_t capacity) :
+        path(std::move(path)), chunk_rows(chunk_rows == 0 ? 1 : chunk_rows), queue(capacity),
+        worker(), done(false), stop(false), fail(false) {
+}
+
+chunk_reader::~chunk_reader() {
+    stop = true;
+    if (worker.joinable())
+        worker.join();
+}
+
+/**
+ * 启动读取线程
+ */
+void chunk_reader::start() {
+    worker = thread(&chunk_reader::produce, this);
+}
+
+/**
+ * 取出一块样本，队列为空时等待
+ * @return 文件读完且队列已空时返回false
+ */
+bool chunk_reader::pop(data_chunk &chunk) {
+    unsigned spins = 0;
+    while (true)
+    {
+        if (queue.try_pop(chunk))
+            return true;
+        if (done.load(memory_order_acquire))
+            return queue.try_pop(chunk);
+        if (++spins < 64)
+            this_thread::yield();
+        else
+            this_thread::sleep_for(chrono::microseconds(50));
+    }
+}
+
+/**
+ * 放入一块样本，队列已满时等待
+ */
+void chunk_reader::push(data_chunk &chunk) {
+    while (!queue.try_push(chunk))
+    {
+        if (stop.load())
+            return;
+        this_thread::sleep_for(chrono::microseconds(50));
+    }
+}
+
+/**
+ * 读取线程：按大块读入文件，逐行用from_chars解析，攒够chunk_rows行放入队列
+ */
+void chunk_reader::produce() {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+    {
+        cout << WARN_FILE_OPEN_FAIL << endl;
+        fail = true;
+        done.store(true, memory_order_release);
+        return;
+    }
+    const size_t block = 1 << 20;
+    vector<char> buf(block);
+    string carry; // 上一块末尾不完整的行
+    data_chunk chunk;
+    chunk.rows.reserve(chunk_rows);
+    auto parse = [&](const char *p, const char *end) {
+        vector<double> line;
+        while (p < end)
+        {
+            // 跳过分隔符
+            while (p < end && (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r'))
+                ++p;
+            if (p >= end)
+                break;
+            double d;
+            auto res = from_chars(p, end, d);
+            if (res.ec != errc())
+                break;
+            line.emplace_back(d);
+            p = res.ptr;
+        }
+        if (!line.empty())
+        {
+            chunk.rows.emplace_back(std::move(line));
+            if (chunk.rows.size() >= chunk_rows)
+            {
+                push(chunk);
+                chunk.rows.clear();
+                chunk.rows.reserve(chunk_rows);
+            }
+        }
+    };
+    size_t n;
+    while (!stop.load() && (n = fread(buf.data(), 1, block, f)) > 0)
+    {
+        const char *p = buf.data();
+        const char *end = p + n;
+        while (p < end)
+        {
+            auto nl = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (nl == nullptr)
+            {
+                carry.append(p, end);
+                break;
+            }
+            if (!carry.empty())
+            {
+                carry.append(p, nl);
+                parse(carry.data(), carry.data() + carry.size());
+                carry.clear();
+            } else
+                parse(p, nl);
+            p = nl + 1;
+        }
+    }
+    if (!carry.empty())
+        parse(carry.data(), carry.data() + carry.size());
+    if (!chunk.rows.empty())
+        push(chunk);
+    fclose(f);
+    done.store(true, memory_order_release);
+}
@@ -0,0 +1,98 @@
+//
+// Created by Jeff on 2019/1/23 0023.
+//
+
+#ifndef ISODATA_READER_H
+#define ISODATA_READER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+/**
+ * 单生产者单消费者的有界无锁队列
+ * 容量向上取整为2的幂，head只由消费者修改，tail只由生产者修改
+ */
+template <typename T>
+class spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity) : head(0), tail(0)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        slots.resize(n);
+        mask = n - 1;
+    }
+    bool try_push(T &v)
+    {
+        auto t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) > mask)
+            return false;
+        slots[t & mask] = std::move(v);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+    bool try_pop(T &v)
+    {
+        auto h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire))
+            return false;
+        v = std::move(slots[h & mask]);
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head;
+    alignas(64) atomic<size_t> tail;
+};
+
+/**
+ * 解析好的一块样本
+ */
+struct data_chunk {
+    vector<vector<double>> rows;
+};
+
+/**
+ * 异步分块读取数据
+ * 读取线程按块解析文件(格式与read_data相同)，放入有界队列，
+ * 消费者在队列为空时等待，文件读完且队列取空后pop返回false
+ */
+class chunk_reader {
+public:
+    /**
+     * 构造函数
+     * @param path 数据文件路径
+     * @param chunk_rows 每块的行数
+     * @param capacity 队列中最多缓存的块数
+     */
+    explicit chunk_reader(string path, size_t chunk_rows = 4096, size_t capacity = 16);
+    chunk_reader(const chunk_reader &) = delete;
+    chunk_reader &operator=(const chunk_reader &) = delete;
+    ~chunk_reader();
+    void start();
+    bool pop(data_chunk &chunk);
+    bool failed() const { return fail.load(); }
+
+private:
+    void produce();
+    void push(data_chunk &chunk);
+
+    string path;
+    size_t chunk_rows;
+    spsc_queue<data_chunk> queue;
+    thread worker;
+    atomic<bool> done; // 生产者是否结束
+    atomic<bool> stop; // 消费者提前结束时通知生产者
+    atomic<bool> fail; // 文件是否打开失败
+};
+
+
+#endif //ISODATA_READER_H
@@ -0,0 +1,152 @@
+//
+// Created by Jeff on 2019/1/29 0029.
+//
+
+#include "scheduler.h"
+#include <chrono>
+#include <algorithm>
+
+/**
+ * @param threads 线程数(包括调用线程)，0表示每个CPU一个线程
+ */
+task_scheduler::task_scheduler(unsigned threads) :
+        nthreads(threads ? threads : max(thread::hardware_concurrency(), 1u)),
+        states(nthreads), workers(), body(nullptr), grain(1), remaining(0),
+        gen(0), pending(0), quit(false), phases() {
+    for (unsigned w = 1; w < nthreads; ++w)
+        workers.emplace_back(&task_scheduler::loop, this, w);
+}
+
+task_scheduler::~task_scheduler() {
+    {
+        lock_guard<mutex> lk(m);
+        quit = true;
+    }
+    cv.notify_all();
+    for (auto &t : workers)
+        t.join();
+}
+
+/**
+ * 并行执行body(begin, end, 线程序号)，覆盖[0, n)，全部完成后返回
+ * @param phase 阶段名称，耗时累计到timings()[phase]
+ * @param grain 单个任务的最大元素数
+ */
+void task_scheduler::parallel_for(const char *phase, size_t n, size_t grain, const BODY &body) {
+    auto start = chrono::steady_clock::now();
+    for (unsigned w = 0; w < nthreads; ++w) {
+        auto &s = states[w];
+        s.busy = 0;
+        s.tasks.clear();
+        auto b = n * w / nthreads, e = n * (w + 1) / nthreads;
+        if (b < e)
+            s.tasks.push_back(range{b, e});
+    }
+    this->grain = max<size_t>(grain, 1);
+    this->body = &body;
+    remaining.store(n);
+    if (nthreads > 1 && n > 0)
+    {
+        {
+            lock_guard<mutex> lk(m);
+            pending = nthreads - 1;
+            ++gen;
+        }
+        cv.notify_all();
+        work(0);
+        unique_lock<mutex> lk(m);
+        done_cv.wait(lk, [this] { return pending == 0; });
+    } else
+        work(0);
+    this->body = nullptr;
+    auto wall = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    auto &t = phases[phase];
+    double busy(0);
+    for (auto &s : states)
+        busy += s.busy;
+    ++t.calls;
+    t.wall += wall;
+    t.busy += busy;
+    t.idle += max(wall * nthreads - busy, 0.0);
+}
+
+/**
+ * 记录不经过调度器执行的阶段，只统计次数与墙钟时间
+ */
+void task_scheduler::record(const char *phase, double wall) {
+    auto &t = phases[phase];
+    ++t.calls;
+    t.wall += wall;
+}
+
+void task_scheduler::loop(unsigned w) {
+    unsigned long long seen = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> lk(m);
+            cv.wait(lk, [&] { return quit || gen != seen; });
+            if (quit)
+                return;
+            seen = gen;
+        }
+        work(w);
+        {
+            lock_guard<mutex> lk(m);
+            if (--pending == 0)
+                done_cv.notify_one();
+        }
+    }
+}
+
+/**
+ * 取一个区间：先从自己队列的尾部取，再依次从其他线程队列的头部窃取
+ */
+bool task_scheduler::take(unsigned w, range &r) {
+    {
+        auto &s = states[w];
+        lock_guard<mutex> lk(s.m);
+        if (!s.tasks.empty())
+        {
+            r = s.tasks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned k = 1; k < nthreads; ++k) {
+        auto &s = states[(w + k) % nthreads];
+        lock_guard<mutex> lk(s.m);
+        if (!s.tasks.empty())
+        {
+            r = s.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void task_scheduler::work(unsigned w) {
+    auto &s = states[w];
+    range r{0, 0};
+    while (remaining.load(memory_order_acquire) > 0)
+    {
+        if (!take(w, r))
+        {
+            this_thread::yield();
+            continue;
+        }
+        // 大区间对半切开，后一半留给自己或被窃取
+        while (r.end - r.begin > grain)
+        {
+            auto mid = r.begin + (r.end - r.begin) / 2;
+            {
+                lock_guard<mutex> lk(s.m);
+                s.tasks.push_back(range{mid, r.end});
+            }
+            r.end = mid;
+        }
+        auto t0 = chrono::steady_clock::now();
+        (*body)(r.begin, r.end, w);
+        s.busy += chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        remaining.fetch_sub(r.end - r.begin, memory_order_acq_rel);
+    }
+}
@@ -0,0 +1,122 @@
+//
+// Created by Jeff on 2019/1/29 0029.
+//
+
+#ifndef ISODATA_SCHEDULER_H
+#define ISODATA_SCHEDULER_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+/**
+ * 一个阶段累计的耗时，单位毫秒
+ * idle为各线程没有执行任务的时间之和，即 线程数*wall - busy
+ */
+struct phase_timing {
+    unsigned long long calls; // 执行次数
+    double wall; // 墙钟时间
+    double busy; // 各线程执行任务的时间之和
+    double idle; // 各线程空闲(等待、窃取)的时间之和
+    phase_timing() : calls(0), wall(0), busy(0), idle(0) {}
+};
+
+/**
+ * 工作窃取的任务调度器
+ * parallel_for把[0, n)按线程数切成初始区间放入各线程的双端队列，
+ * 线程从自己队列的尾部取区间，区间大于grain时对半切开，后一半放回自己的队列；
+ * 自己的队列为空时从其他线程队列的头部窃取，头部是最早放入、也就是最大的区间。
+ * 调用线程作为0号线程参与执行，线程数为1时不创建线程
+ */
+class task_scheduler {
+public:
+    typedef function<void(size_t, size_t, unsigned)> BODY;
+    explicit task_scheduler(unsigned threads = 0);
+    task_scheduler(const task_scheduler &) = delete;
+    task_scheduler &operator=(const task_scheduler &) = delete;
+    ~task_scheduler();
+    unsigned size() const { return nthreads; }
+    void parallel_for(const char *phase, size_t n, size_t grain, const BODY &body);
+    /**
+     * 以引用包装body，按引用捕获较多变量的lambda也不会在构造BODY时申请堆内存
+     */
+    template <typename F>
+    void parallel_for(const char *phase, size_t n, size_t grain, const F &body)
+    {
+        parallel_for(phase, n, grain, BODY(std::cref(body)));
+    }
+    void record(const char *phase, double wall);
+    const map<string, phase_timing> &timings() const { return phases; }
+    void reset_timings() { phases.clear(); }
+
+private:
+    struct range {
+        size_t begin, end;
+    };
+    /**
+     * 用vector实现的双端队列，头部出队只移动head，尾部入队空间不足时先把剩余区间移到开头，
+     * 队列中同时存在的区间数不超过切分深度，预留的空间用完之前不申请内存
+     * (std::deque在窃取使头部跨过内存块时会重新申请块)
+     */
+    struct range_deque {
+        vector<range> items;
+        size_t head = 0;
+        range_deque() { items.reserve(64); }
+        bool empty() const { return head == items.size(); }
+        void clear()
+        {
+            items.clear();
+            head = 0;
+        }
+        void push_back(range r)
+        {
+            if (items.size() == items.capacity() && head > 0)
+            {
+                items.erase(items.begin(), items.begin() + static_cast<ptrdiff_t>(head));
+                head = 0;
+            }
+            items.push_back(r);
+        }
+        range pop_back()
+        {
+            auto r = items.back();
+            items.pop_back();
+            if (empty())
+                clear();
+            return r;
+        }
+        range pop_front() { return items[head++]; }
+    };
+    struct alignas(64) worker_state {
+        mutex m;
+        range_deque tasks;
+        double busy; // 本次parallel_for中执行任务的时间
+    };
+    void loop(unsigned w);
+    void work(unsigned w);
+    bool take(unsigned w, range &r);
+
+    unsigned nthreads;
+    vector<worker_state> states;
+    vector<thread> workers;
+    mutex m;
+    condition_variable cv; // 通知有新任务
+    condition_variable done_cv; // 通知辅助线程退出本次任务
+    const BODY *body;
+    size_t grain;
+    atomic<size_t> remaining; // 尚未执行完的元素个数
+    unsigned long long gen; // 任务的代数
+    unsigned pending; // 尚未退出本次任务的辅助线程数
+    bool quit;
+    map<string, phase_timing> phases;
+};
+
+
+#endif //ISODATA_SCHEDULER_H
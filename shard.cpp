@@ -0,0 +1,269 @@
+//
+// Created by Jeff on 2019/1/20 0020.
+//
+
+#include "shard.h"
+#include "error.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+shard_worker::shard_worker(int fd, vector<vector<double>> &&rows) :
+        fd(fd), row(static_cast<unsigned>(rows.size())),
+        col(rows.empty() ? 0 : static_cast<unsigned>(rows[0].size())),
+        data(), labels(rows.size(), 0), k(0), centers() {
+    data.reserve(static_cast<size_t>(row) * col);
+    for (auto &r : rows)
+    {
+        if (r.size() != col)
+        {
+            cout << WARN_DATA_SIZE << endl;
+            r.resize(col, 0);
+        }
+        data.insert(data.end(), r.begin(), r.end());
+    }
+    rows.clear();
+    rows.shrink_to_fit();
+}
+
+/**
+ * 消息循环，直到收到MSG_QUIT或者连接断开
+ */
+void shard_worker::serve() {
+    msg_buffer hello;
+    hello.put<uint32_t>(row);
+    hello.put<uint32_t>(col);
+    if (!send_msg(fd, MSG_HELLO, hello))
+        return;
+    msg_buffer in, out;
+    uint32_t type;
+    while (recv_msg(fd, type, in))
+    {
+        out.clear();
+        switch (type)
+        {
+            case MSG_SEED: on_seed(in, out); break;
+            case MSG_ASSIGN: on_assign(in, out); break;
+            case MSG_STATS: on_stats(out); break;
+            case MSG_MEANDIS: on_meandis(in, out); break;
+            case MSG_MOVE: on_move(in, out); break;
+            case MSG_SPLIT: on_split(in, out); break;
+            case MSG_RELABEL: on_relabel(in); break;
+            case MSG_QUIT: return;
+            default:
+                cout << WARN_IPC_FAIL << endl;
+                return;
+        }
+        // 负载不完整，不再应答，协调进程按通信失败处理
+        if (!in.good())
+        {
+            cout << WARN_IPC_FAIL << endl;
+            return;
+        }
+        if (!send_msg(fd, MSG_REPLY, out))
+            return;
+    }
+}
+
+/**
+ * 样本r到中心c的欧式距离
+ */
+double shard_worker::distance(unsigned r, const double *c) const {
+    const double *p = data.data() + static_cast<size_t>(r) * col;
+    double res(0);
+    for (unsigned i = 0; i < col; ++i) {
+        double d = p[i] - c[i];
+        res += d * d;
+    }
+    return sqrt(res);
+}
+
+/**
+ * 最近的聚类中心，距离相同时取序号小的，与isodata::get_nearest_cluster一致
+ * @param ignore 非空时，值为1的聚类不做考虑
+ */
+unsigned shard_worker::nearest(unsigned r, const vector<char> &ignore) const {
+    unsigned c_index = k;
+    double dis(0);
+    for (unsigned i = 0; i < k; ++i) {
+        if (!ignore.empty() && ignore[i])
+            continue;
+        auto d = distance(r, centers.data() + static_cast<size_t>(i) * col);
+        if (c_index == k || d < dis)
+        {
+            dis = d;
+            c_index = i;
+        }
+    }
+    return c_index;
+}
+
+/**
+ * 读取负载中的聚类个数与中心
+ */
+void shard_worker::read_centers(msg_buffer &in) {
+    auto n = in.get<uint32_t>();
+    if (col == 0 || n > in.left() / (col * sizeof(double)))
+    {
+        in.fail();
+        return;
+    }
+    k = n;
+    centers.resize(static_cast<size_t>(k) * col);
+    in.get(centers.data(), centers.size());
+}
+
+/**
+ * 写入指定聚类的统计量：样本数、各维的和、各维的平方和
+ */
+void shard_worker::put_stats(msg_buffer &out, const vector<unsigned> &which) const {
+    vector<int> slot(k, -1);
+    for (unsigned i = 0; i < which.size(); ++i)
+        slot[which[i]] = i;
+    const size_t width = 1 + 2 * static_cast<size_t>(col);
+    vector<double> stats(which.size() * width, 0);
+    for (unsigned r = 0; r < row; ++r) {
+        if (labels[r] >= k || slot[labels[r]] < 0)
+            continue;
+        double *s = stats.data() + slot[labels[r]] * width;
+        const double *p = data.data() + static_cast<size_t>(r) * col;
+        s[0] += 1;
+        for (unsigned i = 0; i < col; ++i) {
+            s[1 + i] += p[i];
+            s[1 + col + i] += p[i] * p[i];
+        }
+    }
+    out.put(stats.data(), stats.size());
+}
+
+/**
+ * 负载：样本个数、随机种子；应答：样本个数、样本
+ */
+void shard_worker::on_seed(msg_buffer &in, msg_buffer &out) {
+    auto m = min(in.get<uint32_t>(), row);
+    std::default_random_engine rand(in.get<uint32_t>());
+    vector<unsigned> ids(row);
+    iota(ids.begin(), ids.end(), 0);
+    // 部分洗牌，只取前m个
+    for (unsigned i = 0; i < m; ++i) {
+        std::uniform_int_distribution<unsigned> rnd(i, row - 1);
+        swap(ids[i], ids[rnd(rand)]);
+    }
+    out.put<uint32_t>(m);
+    for (unsigned i = 0; i < m; ++i)
+        out.put(data.data() + static_cast<size_t>(ids[i]) * col, col);
+}
+
+/**
+ * 负载：聚类中心；应答：全部聚类的统计量
+ */
+void shard_worker::on_assign(msg_buffer &in, msg_buffer &out) {
+    read_centers(in);
+    const vector<char> none;
+    for (unsigned r = 0; r < row; ++r)
+        labels[r] = nearest(r, none);
+    on_stats(out);
+}
+
+void shard_worker::on_stats(msg_buffer &out) {
+    vector<unsigned> all(k);
+    iota(all.begin(), all.end(), 0);
+    put_stats(out, all);
+}
+
+/**
+ * 负载：聚类中心；应答：各聚类内样本到中心的距离和
+ */
+void shard_worker::on_meandis(msg_buffer &in, msg_buffer &out) {
+    read_centers(in);
+    vector<double> dis(k, 0);
+    for (unsigned r = 0; r < row; ++r) {
+        if (labels[r] < k)
+            dis[labels[r]] += distance(r, centers.data() + static_cast<size_t>(labels[r]) * col);
+    }
+    out.put(dis.data(), dis.size());
+}
+
+/**
+ * 负载：源聚类、被排除的聚类集合；应答：各聚类的样本数
+ */
+void shard_worker::on_move(msg_buffer &in, msg_buffer &out) {
+    auto src = in.get<uint32_t>();
+    auto n = in.get<uint32_t>();
+    if (n > in.left() / sizeof(uint32_t))
+    {
+        in.fail();
+        return;
+    }
+    vector<char> ignore(k, 0);
+    for (unsigned i = 0; i < n; ++i) {
+        auto e = in.get<uint32_t>();
+        if (e < k)
+            ignore[e] = 1;
+    }
+    vector<double> counts(k, 0);
+    for (unsigned r = 0; r < row; ++r) {
+        if (labels[r] == src)
+        {
+            auto c = nearest(r, ignore);
+            if (c < k)
+                labels[r] = c;
+        }
+        if (labels[r] < k)
+            counts[labels[r]] += 1;
+    }
+    out.put(counts.data(), counts.size());
+}
+
+/**
+ * 负载：被分裂的聚类、新聚类编号、两个新中心；应答：两个聚类的统计量
+ */
+void shard_worker::on_split(msg_buffer &in, msg_buffer &out) {
+    auto src = in.get<uint32_t>();
+    auto dst = in.get<uint32_t>();
+    vector<double> c1(col), c2(col);
+    in.get(c1.data(), col);
+    in.get(c2.data(), col);
+    // 新聚类的编号只能是已有聚类之后的第一个
+    if (!in.good() || src >= k || dst > k)
+    {
+        in.fail();
+        return;
+    }
+    if (dst == k)
+    {
+        k = dst + 1;
+        centers.resize(static_cast<size_t>(k) * col);
+    }
+    for (unsigned r = 0; r < row; ++r) {
+        if (labels[r] == src && distance(r, c2.data()) < distance(r, c1.data()))
+            labels[r] = dst;
+    }
+    put_stats(out, {src, dst});
+}
+
+/**
+ * 负载：旧的聚类个数、新的聚类个数、旧编号到新编号的映射
+ * 映射为-1或者超出映射范围的样本暂不属于任何聚类，等待下一次重新分配
+ */
+void shard_worker::on_relabel(msg_buffer &in) {
+    auto oldk = in.get<uint32_t>();
+    auto newk = in.get<uint32_t>();
+    if (oldk > in.left() / sizeof(int32_t))
+    {
+        in.fail();
+        return;
+    }
+    vector<int32_t> mapping(oldk);
+    in.get(mapping.data(), oldk);
+    for (auto &l : labels) {
+        if (l < oldk && mapping[l] >= 0)
+            l = static_cast<unsigned>(mapping[l]);
+        else
+            l = newk;
+    }
+    k = newk;
+    centers.resize(static_cast<size_t>(k) * col);
+}
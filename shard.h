@@ -0,0 +1,49 @@
+//
+// Created by Jeff on 2019/1/20 0020.
+//
+
+#ifndef ISODATA_SHARD_H
+#define ISODATA_SHARD_H
+
+#include <vector>
+#include "protocol.h"
+
+using namespace std;
+
+// 分布式模式下的分片进程
+// 每个分片只持有自己的一部分样本以及这些样本所属的聚类编号，
+// 根据协调进程的指令计算局部统计量，所有的分裂/合并/删除判断都由协调进程完成
+class shard_worker {
+public:
+    /**
+     * 构造函数
+     * @param fd 与协调进程通信的套接字
+     * @param rows 本分片的样本
+     */
+    shard_worker(int fd, vector<vector<double>> &&rows);
+    void serve();
+
+private:
+    int fd;
+    unsigned row; // 本分片的样本个数
+    unsigned col; // 特征个数
+    vector<double> data; // 按行连续存放的样本
+    vector<unsigned> labels; // 每个样本所属的聚类
+    unsigned k; // 当前聚类个数
+    vector<double> centers; // 最近一次下发的聚类中心，按行连续存放
+
+    double distance(unsigned r, const double *c) const;
+    unsigned nearest(unsigned r, const vector<char> &ignore) const;
+    void read_centers(msg_buffer &in);
+    void put_stats(msg_buffer &out, const vector<unsigned> &which) const;
+    void on_seed(msg_buffer &in, msg_buffer &out);
+    void on_assign(msg_buffer &in, msg_buffer &out);
+    void on_stats(msg_buffer &out);
+    void on_meandis(msg_buffer &in, msg_buffer &out);
+    void on_move(msg_buffer &in, msg_buffer &out);
+    void on_split(msg_buffer &in, msg_buffer &out);
+    void on_relabel(msg_buffer &in);
+};
+
+
+#endif //ISODATA_SHARD_H
@@ -0,0 +1,142 @@
+//
+// Created by Jeff on 2019/1/25 0025.
+//
+
+#include "sparse.h"
+#include "error.h"
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * 第r行与稠密矢量的内积
+ */
+double csr_matrix::dot(unsigned r, const vector<double> &dense) const {
+    double res(0);
+    for (size_t k = indptr[r]; k < indptr[r + 1]; ++k)
+        res += values[k] * dense[indices[k]];
+    return res;
+}
+
+/**
+ * acc += w * 第r行
+ */
+void csr_matrix::add_to(unsigned r, double *acc, double w) const {
+    for (size_t k = indptr[r]; k < indptr[r + 1]; ++k)
+        acc[indices[k]] += w * values[k];
+}
+
+/**
+ * acc += w * 第r行各元素的平方
+ */
+void csr_matrix::add_sq_to(unsigned r, double *acc, double w) const {
+    for (size_t k = indptr[r]; k < indptr[r + 1]; ++k)
+        acc[indices[k]] += w * values[k] * values[k];
+}
+
+/**
+ * 第r行的稠密形式
+ */
+vector<double> csr_matrix::dense_row(unsigned r) const {
+    vector<double> res(cols, 0);
+    add_to(r, res.data());
+    return res;
+}
+
+/**
+ * 两行是否完全相同，要求每行内列号升序
+ */
+bool csr_matrix::same_row(unsigned a, unsigned b) const {
+    auto na = indptr[a + 1] - indptr[a];
+    auto nb = indptr[b + 1] - indptr[b];
+    if (na != nb)
+        return false;
+    return equal(indices.begin() + indptr[a], indices.begin() + indptr[a + 1], indices.begin() + indptr[b]) &&
+           equal(values.begin() + indptr[a], values.begin() + indptr[a + 1], values.begin() + indptr[b]);
+}
+
+/**
+ * 读取libsvm格式的稀疏数据
+ * 每行一个样本，形如 "[label] index:value index:value ..."，不含':'的项(标签)与键不是列号的项(如qid:)被忽略
+ * 同一行中重复的列号只保留最后一次出现的值
+ * @param path 文件路径
+ * @param cols 特征个数，0表示取出现过的最大列号+1
+ * @param one_based 列号是否从1开始(libsvm的约定)
+ * @return
+ */
+csr_matrix read_libsvm(const string &path, unsigned cols, bool one_based)
+{
+    csr_matrix m;
+    ifstream f(path);
+    if (!f.is_open())
+    {
+        cout << WARN_FILE_OPEN_FAIL << endl;
+        return m;
+    }
+    unsigned max_col(0);
+    string s;
+    vector<pair<unsigned, double>> line;
+    while (getline(f, s))
+    {
+        line.clear();
+        const char *p = s.c_str();
+        while (*p)
+        {
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+                ++p;
+            if (!*p)
+                break;
+            const char *tok = p;
+            while (*p && *p != ' ' && *p != '\t' && *p != '\r')
+                ++p;
+            auto colon = static_cast<const char *>(memchr(tok, ':', static_cast<size_t>(p - tok)));
+            if (colon == nullptr)
+                continue;
+            char *key_end;
+            auto idx = strtol(tok, &key_end, 10);
+            if (key_end == tok || key_end != colon)
+                continue;
+            auto val = strtod(colon + 1, nullptr);
+            if (one_based)
+                --idx;
+            if (idx < 0 || (cols && idx >= cols))
+            {
+                cout << WARN_DATA_SIZE << endl;
+                continue;
+            }
+            line.emplace_back(static_cast<unsigned>(idx), val);
+        }
+        // 空行跳过，只有标签的行是全零样本
+        if (s.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        // 按列号稳定排序，重复的列号相邻且保持出现顺序
+        stable_sort(line.begin(), line.end(), [](const pair<unsigned, double> &a, const pair<unsigned, double> &b) {
+            return a.first < b.first;
+        });
+        double norm(0);
+        for (size_t i = 0; i < line.size(); ++i) {
+            auto &item = line[i];
+            if (i + 1 < line.size() && line[i + 1].first == item.first)
+            {
+                cout << WARN_POINT_REPEAT << endl;
+                continue;
+            }
+            // 显式的0不保存，但它的列号计入列数
+            max_col = max(max_col, item.first + 1);
+            if (item.second == 0)
+                continue;
+            m.indices.push_back(item.first);
+            m.values.push_back(item.second);
+            norm += item.second * item.second;
+        }
+        m.indptr.push_back(m.values.size());
+        m.sqnorm.push_back(norm);
+        ++m.rows;
+    }
+    m.cols = cols ? cols : max_col;
+    m.indices.shrink_to_fit();
+    m.values.shrink_to_fit();
+    return m;
+}
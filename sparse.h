@@ -0,0 +1,37 @@
+//
+// Created by Jeff on 2019/1/25 0025.
+//
+
+#ifndef ISODATA_SPARSE_H
+#define ISODATA_SPARSE_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * CSR格式的稀疏样本矩阵
+ * 第r行的非零元为 indices/values[indptr[r], indptr[r+1])，列号从0开始
+ */
+struct csr_matrix {
+    unsigned rows; // 行数，也就是样本个数
+    unsigned cols; // 列数，也就是特征个数
+    vector<size_t> indptr;
+    vector<unsigned> indices;
+    vector<double> values;
+    vector<double> sqnorm; // 每行的平方范数
+    csr_matrix() : rows(0), cols(0), indptr(1, 0), indices(), values(), sqnorm() {}
+    size_t nnz() const { return values.size(); }
+    double dot(unsigned r, const vector<double> &dense) const;
+    void add_to(unsigned r, double *acc, double w = 1) const;
+    void add_sq_to(unsigned r, double *acc, double w = 1) const;
+    vector<double> dense_row(unsigned r) const;
+    bool same_row(unsigned a, unsigned b) const;
+};
+
+csr_matrix read_libsvm(const string &path, unsigned cols = 0, bool one_based = true);
+
+
+#endif //ISODATA_SPARSE_H
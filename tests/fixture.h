@@ -0,0 +1,35 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+#ifndef ISODATA_FIXTURE_H
+#define ISODATA_FIXTURE_H
+
+#include <memory>
+#include "test_util.h"
+#include "../isodata.h"
+
+/**
+ * isodata构造函数的参数，含义与isodata相同
+ */
+struct iso_params {
+    unsigned c, nc, tn;
+    double te, tc;
+    unsigned nt, ns;
+};
+
+/**
+ * 在data的副本上构造isodata：不写文件、不打印，使用固定的种子；
+ * 调用者再做其他设置，然后run()
+ */
+inline unique_ptr<isodata> make_isodata(const vector<vector<double>> &data, const iso_params &p, unsigned seed)
+{
+    unique_ptr<isodata> iso(new isodata(p.c, p.nc, p.tn, p.te, p.tc, p.nt, p.ns,
+                                        [copy = data]() mutable { return std::move(copy); }));
+    iso->set_output(quiet_output());
+    iso->set_seed(seed);
+    return iso;
+}
+
+
+#endif //ISODATA_FIXTURE_H
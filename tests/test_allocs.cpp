@@ -0,0 +1,49 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 聚类结构稳定之后，每次迭代都不再申请堆内存
+// 与alloc_count.cpp一起编译，统计的是全局operator new的全部调用
+
+#include "fixture.h"
+
+/**
+ * 在稳定的高斯团上运行，返回预热(前warm次迭代)之后申请内存的总次数
+ */
+template <typename F>
+static unsigned long long steady_allocs(F setup, unsigned warm = 3)
+{
+    auto iso = make_isodata(make_blobs(2000, 4, 4, 1.0, 50, 3), iso_params{4, 4, 10, 1e6, 5, 2, 12}, 1);
+    setup(*iso);
+    iso->run();
+    auto &allocs = iso->iteration_allocs();
+    CHECK(allocs.size() == 12);
+    CHECK(iso->get_clusters().size() == 4);
+    unsigned long long res(0);
+    for (size_t i = warm; i < allocs.size(); ++i)
+        res += allocs[i];
+    return res;
+}
+
+int main() {
+    CHECK(heap_counting);
+    CHECK(steady_allocs([](isodata &) {}) == 0);
+    CHECK(steady_allocs([](isodata &iso) { iso.set_threads(2); }) == 0);
+    CHECK(steady_allocs([](isodata &iso) { iso.set_threads(2); iso.set_deterministic(true); }) == 0);
+    CHECK(steady_allocs([](isodata &iso) { iso.set_quantized(true); }) == 0);
+    CHECK(steady_allocs([](isodata &iso) { iso.set_metric(METRIC_DIAGONAL); }) == 0);
+    CHECK(steady_allocs([](isodata &iso) {
+        numa_config cfg;
+        cfg.enabled = true;
+        cfg.threads = 2;
+        iso.set_numa(cfg);
+    }) == 0);
+    CHECK(steady_allocs([](isodata &iso) {
+        numa_config cfg;
+        cfg.enabled = true;
+        cfg.threads = 2;
+        iso.set_numa(cfg);
+        iso.set_deterministic(true);
+    }) == 0);
+    return test_result("test_allocs");
+}
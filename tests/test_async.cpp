@@ -0,0 +1,123 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 异步读取：与同一种子下setData的结果划分相同(聚类编号可以不同)，中心相同；
+// 行宽不一致、文件不存在、样本太少时不运行，并给出警告
+
+#include "fixture.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <cstdlib>
+#include <unistd.h>
+
+static void write_rows(const string &path, const vector<vector<double>> &rows)
+{
+    ofstream out(path);
+    out << setprecision(17);
+    for (auto &line : rows)
+        out << line << '\n';
+}
+
+/**
+ * 以异步读取运行，返回运行时输出到cout的内容
+ */
+static string run_async(isodata &iso, const string &path, size_t chunk_rows, size_t seed_rows)
+{
+    iso.set_async_source(path, chunk_rows, seed_rows);
+    stringstream captured;
+    auto old = cout.rdbuf(captured.rdbuf());
+    iso.run();
+    cout.rdbuf(old);
+    return captured.str();
+}
+
+/**
+ * 两组标签是否是同一个划分，即存在编号之间的一一对应
+ */
+static bool same_partition(const vector<int32_t> &a, const vector<int32_t> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    map<int32_t, int32_t> fwd, back;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (fwd.emplace(a[i], b[i]).first->second != b[i])
+            return false;
+        if (back.emplace(b[i], a[i]).first->second != a[i])
+            return false;
+    }
+    return true;
+}
+
+static vector<vector<double>> centers_of(const isodata &iso)
+{
+    vector<vector<double>> res;
+    for (auto &cluster : iso.get_clusters())
+        res.push_back(cluster.center);
+    return sorted_centers(res);
+}
+
+int main() {
+    char dir[] = "/tmp/isodata_test_XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+    {
+        cerr << "cannot create temporary directory" << endl;
+        return 1;
+    }
+    const string path = string(dir) + "/data.txt";
+    const iso_params p{4, 4, 10, 40, 5, 2, 10};
+    auto data = make_blobs(600, 4, 3, 1.0, 40, 19);
+    write_rows(path, data);
+
+    auto sync = make_isodata(data, p, 6);
+    sync->run();
+    auto expect = centers_of(*sync);
+    // 块比数据小得多，读取、初始化与第一次分配交错进行；seed_rows为0时按64*_nc行
+    for (size_t chunk : {size_t(50), size_t(4096)}) {
+        for (size_t seed_rows : {size_t(0), size_t(1000)}) {
+            auto iso = make_isodata({}, p, 6);
+            run_async(*iso, path, chunk, seed_rows);
+            CHECK(same_partition(iso->labels(), sync->labels()));
+            auto got = centers_of(*iso);
+            CHECK(got.size() == expect.size());
+            for (size_t j = 0; j < got.size() && j < expect.size(); ++j)
+                CHECK(max_abs_diff(got[j], expect[j]) < 1e-9);
+        }
+    }
+
+    // 第800行少一维：丢弃全部数据，不运行
+    auto ragged = data;
+    ragged[800].pop_back();
+    write_rows(path, ragged);
+    {
+        auto iso = make_isodata({}, p, 6);
+        auto printed = run_async(*iso, path, 100, 0);
+        CHECK(printed.find(WARN_DATA_SIZE) != string::npos);
+        CHECK(iso->get_clusters().empty());
+        CHECK(iso->labels().empty());
+    }
+
+    // 样本数少于_c
+    write_rows(path, vector<vector<double>>(data.begin(), data.begin() + 3));
+    {
+        auto iso = make_isodata({}, p, 6);
+        auto printed = run_async(*iso, path, 100, 0);
+        CHECK(printed.find(WARN_DATA_SIZE) != string::npos);
+        CHECK(iso->get_clusters().empty());
+        CHECK(iso->labels().empty());
+    }
+    unlink(path.c_str());
+
+    // 文件不存在
+    {
+        auto iso = make_isodata({}, p, 6);
+        auto printed = run_async(*iso, path, 100, 0);
+        CHECK(printed.find(WARN_FILE_OPEN_FAIL) != string::npos);
+        CHECK(iso->get_clusters().empty());
+        CHECK(iso->labels().empty());
+    }
+    rmdir(dir);
+    return test_result("test_async");
+}
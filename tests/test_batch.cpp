@@ -0,0 +1,51 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// batch_runner中每个数据集的结果与单独构造isodata、使用同一种子(seed+序号)运行的结果完全相同
+
+#include "fixture.h"
+#include "../batch.h"
+
+int main() {
+    const unsigned n = 200, seed = 17;
+    const iso_params p{4, 4, 5, 8, 2, 2, 15};
+    vector<vector<vector<double>>> sets;
+    batch_runner batch(p.c, p.nc, p.tn, p.te, p.tc, p.nt, p.ns, 4);
+    batch.set_seed(seed);
+    for (unsigned i = 0; i < n; ++i) {
+        // 样本数与维数各不相同
+        sets.push_back(make_blobs(20 + i % 17, 4, 2 + i % 3, 1.0, 20, 100 + i));
+        CHECK(batch.add(sets.back()));
+    }
+    CHECK(batch.size() == n);
+
+    vector<char> seen(n, 0);
+    batch.run([&](const batch_result &res) {
+        CHECK(res.index < n);
+        if (res.index >= n)
+            return;
+        CHECK(!seen[res.index]);
+        seen[res.index] = 1;
+        auto &data = sets[res.index];
+        auto single = make_isodata(data, p, seed + static_cast<unsigned>(res.index));
+        single->run();
+        CHECK(res.rows == data.size());
+        CHECK(res.cols == data[0].size());
+        CHECK(res.labels == single->labels());
+        CHECK(res.all_mean_dis == single->mean_distance());
+        auto &clusters = single->get_clusters();
+        CHECK(res.centers.size() == clusters.size());
+        for (size_t j = 0; j < res.centers.size() && j < clusters.size(); ++j) {
+            CHECK(res.centers[j] == clusters[j].center);
+            CHECK(res.sizes[j] == clusters[j].ids.size());
+        }
+    });
+    CHECK(count(seen.begin(), seen.end(), 1) == n);
+
+    // 行宽不一致、样本太少的数据集不加入
+    CHECK(!batch.add({{1, 2}, {3}}));
+    CHECK(!batch.add({{1, 2}}));
+    CHECK(batch.size() == n);
+    return test_result("test_batch");
+}
@@ -0,0 +1,73 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 内存预算：估计超出预算时改为float存储，仍超出时给出一次WARN_MEMORY_BUDGET；
+// 各类别的内存峰值都有记录，float存储的样本峰值更小；分配结果与不设预算时相同
+
+#include "fixture.h"
+#include <sstream>
+
+struct budget_run {
+    vector<int32_t> labels;
+    bool compact;
+    memory_usage mem;
+    string printed; // 运行时输出到cout的内容
+};
+
+static budget_run run_with(const vector<vector<double>> &data, size_t budget, size_t coreset = 0)
+{
+    auto iso = make_isodata(data, iso_params{4, 4, 10, 40, 5, 2, 10}, 3);
+    iso->set_memory_budget(budget);
+    if (coreset)
+        iso->set_coreset(coreset);
+    stringstream captured;
+    auto old = cout.rdbuf(captured.rdbuf());
+    iso->run();
+    cout.rdbuf(old);
+    return budget_run{iso->labels(), iso->is_compact(), iso->memory(), captured.str()};
+}
+
+static size_t warnings(const string &printed)
+{
+    size_t n(0);
+    for (auto pos = printed.find(WARN_MEMORY_BUDGET); pos != string::npos;
+         pos = printed.find(WARN_MEMORY_BUDGET, pos + 1))
+        ++n;
+    return n;
+}
+
+int main() {
+    // 2000行2列：double存储每行约92字节，float存储每行约44字节
+    auto data = make_blobs(500, 4, 2, 1.0, 50, 3);
+
+    auto plain = run_with(data, 0);
+    CHECK(!plain.compact);
+    CHECK(warnings(plain.printed) == 0);
+    for (int c = 0; c < MEM_CATEGORIES; ++c) {
+        CHECK(plain.mem.peak[c] > 0);
+        CHECK(plain.mem.peak[c] >= plain.mem.current[c]);
+    }
+    CHECK(plain.mem.total_peak >= plain.mem.peak[MEM_SAMPLES]);
+
+    // 预算介于两种存储之间：转为float，不警告
+    auto fits = run_with(data, 120000);
+    CHECK(fits.compact);
+    CHECK(warnings(fits.printed) == 0);
+    CHECK(fits.labels == plain.labels);
+    CHECK(fits.mem.peak[MEM_SAMPLES] > 0);
+    CHECK(fits.mem.peak[MEM_SAMPLES] < plain.mem.peak[MEM_SAMPLES]);
+
+    // 转为float之后仍然超出：只警告一次，照常运行
+    auto over = run_with(data, 1000);
+    CHECK(over.compact);
+    CHECK(warnings(over.printed) == 1);
+    CHECK(over.labels == plain.labels);
+
+    // coreset要按double保留全部数据，不转换，只警告
+    auto core = run_with(data, 1000, 400);
+    CHECK(!core.compact);
+    CHECK(warnings(core.printed) == 1);
+    CHECK(core.labels.size() == data.size());
+    return test_result("test_budget");
+}
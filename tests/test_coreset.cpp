@@ -0,0 +1,66 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// coreset：在coreset上聚类并在全部数据上refine，结果与全部数据上的运行相近；
+// 带权重的样本经过分裂与合并之后，聚类缓存的权重之和(mass)仍等于其中样本的权重之和
+
+#include "fixture.h"
+#include "../coreset.h"
+
+int main() {
+    const double spread = 2.0;
+    const size_t m = 1000;
+    const unsigned seed = 5;
+    auto data = make_blobs(1000, 5, 2, spread, 30, 23);
+    // 从1个聚类开始分裂，相距小于tc的聚类合并
+    const iso_params p{8, 1, 10, 100, 5, 2, 10};
+
+    auto full = make_isodata(data, p, seed);
+    full->run();
+    auto core = make_isodata(data, p, seed);
+    core->set_coreset(m);
+    core->run();
+    // 聚类个数相同，每个中心与全部数据上的最近中心相距不超过0.1倍类内标准差，平均距离相差不超过1%
+    auto &expect = full->get_clusters();
+    auto &got = core->get_clusters();
+    CHECK(got.size() == expect.size());
+    for (auto &e : expect) {
+        double best = HUGE_VAL;
+        for (auto &g : got)
+            best = min(best, get_distance(e.center, g.center));
+        CHECK(best < 0.1 * spread);
+    }
+    CHECK(fabs(core->mean_distance() - full->mean_distance()) < 0.01 * full->mean_distance());
+    // refine之后不再带权重，每个样本计1
+    for (auto &cluster : got)
+        CHECK(cluster.weight == cluster.ids.size());
+
+    // refine_passes为0：聚类保持coreset上的成员关系，样本序号即coreset中的序号
+    vector<double> weights;
+    lightweight_coreset(data, m, seed, weights);
+    double total(0);
+    for (auto w : weights)
+        total += w;
+    auto raw = make_isodata(data, p, seed);
+    raw->set_coreset(m, 0);
+    raw->run();
+    auto no_merge = p;
+    no_merge.tc = 0;
+    auto unmerged = make_isodata(data, no_merge, seed);
+    unmerged->set_coreset(m, 0);
+    unmerged->run();
+    // 分裂与合并都发生了
+    CHECK(raw->get_clusters().size() > 1);
+    CHECK(raw->get_clusters().size() < unmerged->get_clusters().size());
+    double sum(0);
+    for (auto &cluster : raw->get_clusters()) {
+        double members(0);
+        for (auto id : cluster.ids)
+            members += id < weights.size() ? weights[id] : HUGE_VAL;
+        CHECK(fabs(members - cluster.weight) < 1e-9 * cluster.weight);
+        sum += cluster.weight;
+    }
+    CHECK(fabs(sum - total) < 1e-9 * total);
+    return test_result("test_coreset");
+}
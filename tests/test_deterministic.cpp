@@ -0,0 +1,67 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 确定性模式下，不同线程数(调度器与NUMA分配)写出的标签与中心文件逐字节相同
+
+#include "fixture.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
+
+static string read_file(const string &path)
+{
+    ifstream in(path, ios::binary);
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+/**
+ * 运行一次并把结果写入dir，返回标签与中心文件的内容
+ */
+static string run_once(const vector<vector<double>> &data, unsigned threads, bool use_numa, const string &dir)
+{
+    auto iso = make_isodata(data, iso_params{6, 6, 10, 20, 2, 2, 12}, 0);
+    auto out = quiet_output();
+    out.prefix = dir + "/";
+    out.formats = OUT_LABELS | OUT_CENTERS;
+    out.threads = threads;
+    iso->set_output(out);
+    iso->set_deterministic(true);
+    iso->set_threads(threads);
+    if (use_numa)
+    {
+        numa_config cfg;
+        cfg.enabled = true;
+        cfg.threads = threads;
+        cfg.pin = false;
+        cfg.simulate_nodes = threads > 1 ? 2 : 0;
+        iso->set_numa(cfg);
+    }
+    iso->run();
+    auto res = read_file(out.prefix + "labels.txt") + read_file(out.prefix + "centers.txt");
+    unlink((out.prefix + "labels.txt").c_str());
+    unlink((out.prefix + "centers.txt").c_str());
+    return res;
+}
+
+int main() {
+    char dir[] = "/tmp/isodata_test_XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+    {
+        cerr << "cannot create temporary directory" << endl;
+        return 1;
+    }
+    // 行数跨过多个4096行的块，各块的累加顺序固定
+    auto data = make_blobs(3000, 6, 5, 2.0, 8, 31);
+    for (bool use_numa : {false, true}) {
+        auto expect = run_once(data, 1, use_numa, dir);
+        CHECK(!expect.empty());
+        for (unsigned threads : {2u, 3u, 5u})
+            CHECK(run_once(data, threads, use_numa, dir) == expect);
+    }
+    rmdir(dir);
+    return test_result("test_deterministic");
+}
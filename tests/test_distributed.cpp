@@ -0,0 +1,88 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 多进程的dist_isodata与单进程的isodata在同一份数据上结果一致：
+// 聚类个数、各聚类的样本数与中心相同(与编号无关)
+
+#include "fixture.h"
+#include "../distributed.h"
+
+/**
+ * 在同一份数据上分别运行isodata与1~3个分片的dist_isodata，比较结果
+ * @return isodata得到的聚类个数
+ */
+static size_t check_same(const vector<vector<double>> &data, const iso_params &p, unsigned seed)
+{
+    auto single = make_isodata(data, p, seed);
+    single->run();
+    vector<vector<double>> expect;
+    vector<double> expect_sizes;
+    for (auto &cluster : single->get_clusters()) {
+        expect.push_back(cluster.center);
+        expect_sizes.push_back(static_cast<double>(cluster.ids.size()));
+    }
+    expect = sorted_centers(expect);
+    sort(expect_sizes.begin(), expect_sizes.end());
+
+    for (unsigned nw : {1u, 2u, 3u}) {
+        // 每个分片进程只生成并保留自己的行
+        dist_isodata dist(p.c, p.nc, p.tn, p.te, p.tc, p.nt, p.ns, nw, [&data](unsigned s, unsigned n) {
+            vector<vector<double>> rows;
+            for (size_t i = s; i < data.size(); i += n)
+                rows.push_back(data[i]);
+            return rows;
+        });
+        dist.set_seed(seed);
+        dist.run();
+        CHECK(dist.good());
+        vector<vector<double>> got;
+        vector<double> sizes;
+        for (auto &cluster : dist.get_clusters()) {
+            got.push_back(cluster.center);
+            sizes.push_back(cluster.n);
+        }
+        got = sorted_centers(got);
+        sort(sizes.begin(), sizes.end());
+        CHECK(got.size() == expect.size());
+        CHECK(sizes == expect_sizes);
+        for (size_t j = 0; j < got.size() && j < expect.size(); ++j)
+            CHECK(max_abs_diff(got[j], expect[j]) < 1e-9);
+        CHECK(fabs(dist.mean_distance() - single->mean_distance()) < 1e-9);
+    }
+    return expect.size();
+}
+
+int main() {
+    const unsigned k = 4, per = 500;
+    // 参数与isodata相同：_c, _nc, _tn, _te, _tc, _nt, _ns
+    // te足够大，不发生分裂与合并
+    CHECK(check_same(make_blobs(per, k, 2, 1.0, 50, 11), iso_params{k, k, 10, 200, 5, 2, 10}, 5) == k);
+
+    // 从1个聚类开始(初始中心与取样无关)，先分裂出多个聚类，之后相距小于tc的聚类两两合并，
+    // 每次迭代最多合并nt次；与tc=0(不合并)相比聚类更少，说明合并确实发生了
+    auto spread = make_blobs(300, 5, 2, 4.0, 40, 21);
+    auto merged = check_same(spread, iso_params{8, 1, 10, 60, 15, 2, 10}, 7);
+    auto unmerged = check_same(spread, iso_params{8, 1, 10, 60, 0, 2, 10}, 7);
+    CHECK(merged > 1);
+    CHECK(merged < unmerged);
+
+    // 关于原点对称的整数样本，中心的各维恰好为0，分裂出的新中心与原中心相同，分裂必然失败；
+    // check_split不能反复重试同一个聚类
+    vector<vector<double>> mirrored;
+    for (int i = 1; i <= 200; ++i) {
+        mirrored.push_back({static_cast<double>(i % 7), static_cast<double>(50 + i % 11)});
+        mirrored.push_back({-static_cast<double>(i % 7), -static_cast<double>(50 + i % 11)});
+    }
+    dist_isodata stuck(4, 1, 1, 10, 0, 1, 4, 2, [&mirrored](unsigned s, unsigned n) {
+        vector<vector<double>> rows;
+        for (size_t i = s; i < mirrored.size(); i += n)
+            rows.push_back(mirrored[i]);
+        return rows;
+    });
+    stuck.set_seed(1);
+    stuck.run();
+    CHECK(stuck.good());
+    CHECK(!stuck.get_clusters().empty());
+    return test_result("test_distributed");
+}
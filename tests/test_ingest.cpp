@@ -0,0 +1,111 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 增量加入样本：返回的标签与输入逐行对齐(维数不对的行为0)且与get_labels一致；
+// 漂移触发的局部分裂与合并之后标签仍然正确；各聚类的充分统计量与按成员重新计算的一致
+
+#include "fixture.h"
+
+/**
+ * 一个高斯团，中心为(x, y)
+ */
+static vector<vector<double>> blob(unsigned n, double x, double y, unsigned seed)
+{
+    std::mt19937 rand(seed);
+    std::normal_distribution<double> noise(0, 1);
+    vector<vector<double>> res;
+    for (unsigned i = 0; i < n; ++i)
+        res.push_back({x + noise(rand), y + noise(rand)});
+    return res;
+}
+
+/**
+ * 加入rows，其中每隔7行插入一行维数不对的样本；检查返回的标签，并把保留的行追加到all
+ */
+static void ingest_checked(isodata &iso, const vector<vector<double>> &rows, vector<vector<double>> &all)
+{
+    vector<vector<double>> input;
+    vector<int> from; // input中每行对应rows中的行，-1表示插入的坏行
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (i % 7 == 3)
+        {
+            input.push_back({1, 2, 3});
+            from.push_back(-1);
+        }
+        input.push_back(rows[i]);
+        from.push_back(static_cast<int>(i));
+    }
+    const auto first = all.size();
+    auto res = iso.ingest(input);
+    CHECK(res.size() == input.size());
+    auto labels = iso.labels();
+    CHECK(labels.size() == first + rows.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < res.size() && i < input.size(); ++i) {
+        if (from[i] < 0)
+        {
+            CHECK(res[i] == 0);
+            continue;
+        }
+        CHECK(res[i] > 0);
+        if (first + kept < labels.size())
+            CHECK(res[i] == labels[first + kept]);
+        ++kept;
+    }
+    all.insert(all.end(), rows.begin(), rows.end());
+}
+
+/**
+ * 各聚类的充分统计量与中心同按成员重新计算的结果一致，每个样本恰好属于一个聚类
+ */
+static void check_stats(const isodata &iso, const vector<vector<double>> &all)
+{
+    size_t members = 0;
+    for (auto &cluster : iso.get_clusters()) {
+        auto &st = cluster.stats;
+        members += cluster.ids.size();
+        vector<double> sum(2, 0), sumsq(2, 0);
+        for (auto id : cluster.ids) {
+            for (unsigned k = 0; k < 2; ++k) {
+                sum[k] += all[id][k];
+                sumsq[k] += all[id][k] * all[id][k];
+            }
+        }
+        CHECK(st.weight == static_cast<double>(cluster.ids.size()));
+        CHECK(max_abs_diff(st.sum, sum) < 1e-6 * (1 + fabs(sum[0]) + fabs(sum[1])));
+        CHECK(max_abs_diff(st.sumsq, sumsq) < 1e-6 * (1 + sumsq[0] + sumsq[1]));
+        for (auto &v : sum)
+            v /= static_cast<double>(cluster.ids.size());
+        CHECK(max_abs_diff(cluster.center, sum) < 1e-9 * (1 + fabs(sum[0]) + fabs(sum[1])));
+    }
+    CHECK(members == all.size());
+}
+
+int main() {
+    // 中心为(50,0)、(0,50)、(100,0)、(0,100)的四个团
+    auto data = make_blobs(500, 4, 2, 1.0, 50, 13);
+    for (double tc : {5.0, 30.0}) {
+        auto iso = make_isodata(data, iso_params{4, 4, 10, 40, tc, 2, 10}, 3);
+        iso->run();
+        CHECK(iso->get_clusters().size() == 4);
+        auto all = data;
+        // 1 落在原有聚类附近的样本，不触发局部调整
+        ingest_checked(*iso, blob(60, 0, 50, 17), all);
+        CHECK(iso->get_clusters().size() == 4);
+        check_stats(*iso, all);
+        // 2 (50,0)下方25处出现一个新团，并入(50,0)的聚类后漂移，分裂成上下两个；
+        // tc=5时两半保留，tc=30时两半的中心相距小于tc，又被局部合并
+        ingest_checked(*iso, blob(800, 50, -25, 19), all);
+        CHECK(iso->get_clusters().size() == (tc < 25 ? 5u : 4u));
+        check_stats(*iso, all);
+        // 3 之后的加入沿用调整后的编号
+        ingest_checked(*iso, blob(40, 50, -25, 23), all);
+        check_stats(*iso, all);
+    }
+    // 稀疏数据或run()之前不支持
+    isodata idle(4, 4, 10, 40, 5, 2, 10, []() { return vector<vector<double>>(); });
+    auto none = idle.ingest({{1, 2}, {3, 4}});
+    CHECK(none == vector<int32_t>(2, 0));
+    return test_result("test_ingest");
+}
@@ -0,0 +1,32 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// check_tn取消样本太少的聚类时，其中的样本分到其余聚类中最近的一个：
+// 查找最近聚类时跳过被取消的聚类，而不是遇到它就停止查找
+
+#include "fixture.h"
+
+int main() {
+    // 三组完全相同的点，初始中心恰好是这三个位置；B只有3个点，少于_tn被取消，最近的是C。
+    // 聚类的顺序随种子变化，其中一部分种子下为A、B、C，遇到B就停止查找时B的样本会分到A
+    vector<vector<double>> data;
+    for (int i = 0; i < 50; ++i)
+        data.push_back({10, 0}); // C
+    for (int i = 0; i < 3; ++i)
+        data.push_back({9, 0}); // B
+    for (int i = 0; i < 50; ++i)
+        data.push_back({0, 0}); // A
+    // 只迭代一次，B的样本所属的聚类由check_tn决定，不会被下一次重新分配纠正
+    for (unsigned seed = 0; seed < 20; ++seed) {
+        auto iso = make_isodata(data, iso_params{3, 3, 5, 100, 0, 1, 1}, seed);
+        iso->run();
+        auto labels = iso->labels();
+        CHECK(iso->get_clusters().size() == 2);
+        CHECK(labels[50] == labels[0]);
+        CHECK(labels[50] != labels[53]);
+        for (auto &cluster : iso->get_clusters())
+            CHECK(cluster.ids.size() == (cluster.center[0] > 5 ? 53u : 50u));
+    }
+    return test_result("test_nearest");
+}
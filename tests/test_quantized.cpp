@@ -0,0 +1,46 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 8位量化样本上的最近中心查找经过复核之后与精确查找的结果完全相同：
+// 每次迭代的分配一致，因此最终的聚类成员与中心逐位相同
+
+#include "fixture.h"
+
+/**
+ * 运行一次，返回各聚类的成员与中心
+ */
+static void run_once(const vector<vector<double>> &data, bool quantized, unsigned threads,
+                     vector<vector<unsigned>> &members, vector<vector<double>> &centers,
+                     unsigned long long &reranks)
+{
+    auto iso = make_isodata(data, iso_params{6, 6, 10, 8, 2, 2, 15}, 7);
+    iso->set_threads(threads);
+    iso->set_quantized(quantized);
+    iso->run();
+    members.clear();
+    centers.clear();
+    for (auto &cluster : iso->get_clusters()) {
+        members.emplace_back(cluster.ids.begin(), cluster.ids.end());
+        sort(members.back().begin(), members.back().end());
+        centers.push_back(cluster.center);
+    }
+    reranks = iso->quantized_reranks();
+}
+
+int main() {
+    // 团之间相距很近，大量样本位于边界附近，量化距离无法区分
+    auto data = make_blobs(1500, 6, 3, 1.0, 3, 21);
+    for (unsigned threads : {1u, 3u}) {
+        vector<vector<unsigned>> expect_members, members;
+        vector<vector<double>> expect_centers, centers;
+        unsigned long long none, reranks;
+        run_once(data, false, threads, expect_members, expect_centers, none);
+        run_once(data, true, threads, members, centers, reranks);
+        CHECK(none == 0);
+        CHECK(reranks > 0);
+        CHECK(members == expect_members);
+        CHECK(centers == expect_centers);
+    }
+    return test_result("test_quantized");
+}
@@ -0,0 +1,126 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 稀疏数据：read_libsvm对qid:、重复列号、显式0与只有标签的行的处理；
+// 同一份数据按稀疏与稠密分别运行，分配结果相同，中心与距离一致
+
+#include "fixture.h"
+#include "../sparse.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
+
+static csr_matrix read_quiet(const string &path, unsigned cols, string &printed)
+{
+    stringstream captured;
+    auto old = cout.rdbuf(captured.rdbuf());
+    auto m = read_libsvm(path, cols);
+    cout.rdbuf(old);
+    printed = captured.str();
+    return m;
+}
+
+static vector<pair<unsigned, double>> row_of(const csr_matrix &m, unsigned r)
+{
+    vector<pair<unsigned, double>> res;
+    for (auto i = m.indptr[r]; i < m.indptr[r + 1]; ++i)
+        res.emplace_back(m.indices[i], m.values[i]);
+    return res;
+}
+
+static void check_fixture(const string &dir)
+{
+    const string path = dir + "/fixture.svm";
+    {
+        ofstream out(path);
+        out << "1 qid:3 1:0.5 3:2 3:4 5:0\n"   // 重复的列3保留最后一次；显式的0不保存
+            << "-1 2:1.5\tqid:7 4:0\r\n"       // qid:不是列号；CRLF行尾
+            << "2\n"                           // 只有标签：全零样本
+            << "\n"                            // 空行跳过
+            << "0 1:1e-3 6:0\n";               // 最大的列号是显式的0
+    }
+    string printed;
+    auto m = read_quiet(path, 0, printed);
+    CHECK(m.rows == 4);
+    CHECK(m.cols == 6);
+    CHECK(m.nnz() == 4);
+    CHECK(row_of(m, 0) == (vector<pair<unsigned, double>>{{0, 0.5}, {2, 4}}));
+    CHECK(row_of(m, 1) == (vector<pair<unsigned, double>>{{1, 1.5}}));
+    CHECK(row_of(m, 2).empty());
+    CHECK(row_of(m, 3) == (vector<pair<unsigned, double>>{{0, 1e-3}}));
+    CHECK(m.sqnorm == (vector<double>{0.25 + 16, 1.5 * 1.5, 0, 1e-3 * 1e-3}));
+    CHECK(printed.find(WARN_POINT_REPEAT) != string::npos);
+    CHECK(printed.find(WARN_DATA_SIZE) == string::npos);
+
+    // 给定列数时超出的列号丢弃并警告
+    m = read_quiet(path, 3, printed);
+    CHECK(m.cols == 3);
+    CHECK(row_of(m, 0) == (vector<pair<unsigned, double>>{{0, 0.5}, {2, 4}}));
+    CHECK(row_of(m, 1) == (vector<pair<unsigned, double>>{{1, 1.5}}));
+    CHECK(printed.find(WARN_DATA_SIZE) != string::npos);
+    unlink(path.c_str());
+}
+
+static csr_matrix to_csr(const vector<vector<double>> &data)
+{
+    csr_matrix m;
+    m.rows = static_cast<unsigned>(data.size());
+    m.cols = static_cast<unsigned>(data[0].size());
+    for (auto &line : data) {
+        double sq(0);
+        for (unsigned i = 0; i < line.size(); ++i) {
+            if (line[i] == 0)
+                continue;
+            m.indices.push_back(i);
+            m.values.push_back(line[i]);
+            sq += line[i] * line[i];
+        }
+        m.indptr.push_back(m.values.size());
+        m.sqnorm.push_back(sq);
+    }
+    return m;
+}
+
+static void check_sparse_dense()
+{
+    // 20维，每团只在一维上偏移，噪声中绝对值小于1的置0，大约七成是0
+    auto data = make_blobs(300, 4, 20, 1.0, 30, 41);
+    for (auto &line : data)
+        for (auto &v : line)
+            if (fabs(v) < 1)
+                v = 0;
+    const iso_params p{4, 4, 10, 100, 5, 2, 10};
+    auto dense = make_isodata(data, p, 8);
+    dense->run();
+    auto sparse = make_isodata({}, p, 8);
+    auto m = to_csr(data);
+    sparse->set_sparse_source([m]() { return m; });
+    sparse->run();
+
+    // 初始中心相同(同一种子取同样的样本)，分配结果与聚类顺序都相同
+    CHECK(sparse->labels() == dense->labels());
+    auto &a = dense->get_clusters();
+    auto &b = sparse->get_clusters();
+    CHECK(a.size() == b.size());
+    for (size_t j = 0; j < a.size() && j < b.size(); ++j) {
+        CHECK(max_abs_diff(a[j].center, b[j].center) < 1e-9);
+        // 稀疏距离按 |x|^2 + |c|^2 - 2x·c 计算，与直接相减的结果只差舍入误差
+        CHECK(fabs(a[j].innerMeanDis - b[j].innerMeanDis) < 1e-9 * a[j].innerMeanDis);
+    }
+    CHECK(fabs(dense->mean_distance() - sparse->mean_distance()) < 1e-9 * dense->mean_distance());
+}
+
+int main() {
+    char dir[] = "/tmp/isodata_test_XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+    {
+        cerr << "cannot create temporary directory" << endl;
+        return 1;
+    }
+    check_fixture(dir);
+    rmdir(dir);
+    check_sparse_dense();
+    return test_result("test_sparse");
+}
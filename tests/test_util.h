@@ -0,0 +1,90 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+#ifndef ISODATA_TEST_UTIL_H
+#define ISODATA_TEST_UTIL_H
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include "../writer.h"
+
+using namespace std;
+
+// 测试用的断言与数据，每个测试是一个独立的可执行文件，失败时返回非0
+
+static int test_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << endl; \
+            ++test_failures; \
+        } \
+    } while (0)
+
+/**
+ * 生成k个相距gap、标准差为spread的高斯团，样本按团轮流排列
+ * @param per 每团的样本数
+ */
+inline vector<vector<double>> make_blobs(unsigned per, unsigned k, unsigned cols,
+                                         double spread, double gap, unsigned seed)
+{
+    std::mt19937 rand(seed);
+    std::normal_distribution<double> noise(0, spread);
+    vector<vector<double>> res;
+    res.reserve(static_cast<size_t>(per) * k);
+    for (unsigned r = 0; r < per; ++r) {
+        for (unsigned j = 0; j < k; ++j) {
+            vector<double> p(cols);
+            for (unsigned i = 0; i < cols; ++i)
+                p[i] = (i == j % cols ? gap * (1 + j / cols) : 0) + noise(rand);
+            res.push_back(p);
+        }
+    }
+    return res;
+}
+
+/**
+ * 不写文件、不打印的输出设置
+ */
+inline output_config quiet_output()
+{
+    output_config cfg;
+    cfg.formats = 0;
+    cfg.print = false;
+    cfg.summary = false;
+    return cfg;
+}
+
+/**
+ * 聚类中心按字典序排序，用于比较与聚类编号无关的结果
+ */
+inline vector<vector<double>> sorted_centers(vector<vector<double>> centers)
+{
+    sort(centers.begin(), centers.end());
+    return centers;
+}
+
+inline double max_abs_diff(const vector<double> &a, const vector<double> &b)
+{
+    double res(0);
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i)
+        res = max(res, fabs(a[i] - b[i]));
+    return a.size() == b.size() ? res : HUGE_VAL;
+}
+
+inline int test_result(const char *name)
+{
+    if (test_failures)
+        cerr << name << ": " << test_failures << " check(s) failed" << endl;
+    else
+        cout << name << ": ok" << endl;
+    return test_failures ? 1 : 0;
+}
+
+
+#endif //ISODATA_TEST_UTIL_H
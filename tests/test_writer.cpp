@@ -0,0 +1,123 @@
+//
+// Created by Jeff on 2019/2/3 0003.
+//
+
+// 结果文件：clusters.txt与原来用ostream逐行写出的内容逐字节相同；
+// labels.txt、labels.bin、centers.txt与内存中的结果一致；mmap写出的文件与普通写出的相同
+
+#include "fixture.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+static const char *const FILES[] = {"clusters.txt", "labels.txt", "labels.bin", "centers.txt"};
+
+static string read_file(const string &path)
+{
+    ifstream in(path, ios::binary);
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+/**
+ * 原来的输出：聚类个数，之后每个聚类一行 编号 样本数，再逐行输出其中的样本
+ */
+static string ostream_members(const isodata &iso, const vector<vector<double>> &data)
+{
+    ostringstream res;
+    auto &clusters = iso.get_clusters();
+    res << clusters.size() << endl;
+    for (size_t j = 0; j < clusters.size(); ++j) {
+        res << j + 1 << " " << clusters[j].ids.size() << endl;
+        for (const auto &id : clusters[j].ids)
+            res << data[id] << endl;
+    }
+    return res.str();
+}
+
+/**
+ * 检查centers.txt：表头与每个聚类的编号、样本数、中心
+ */
+static void check_centers(const string &text, const isodata &iso)
+{
+    auto &clusters = iso.get_clusters();
+    istringstream in(text);
+    string line;
+    CHECK(getline(in, line) && line.rfind("# clusters=" + to_string(clusters.size()) + " rows=", 0) == 0);
+    for (size_t j = 0; j < clusters.size(); ++j) {
+        CHECK(getline(in, line));
+        vector<double> fields;
+        istringstream ls(line);
+        string field;
+        while (getline(ls, field, ','))
+            fields.push_back(strtod(field.c_str(), nullptr));
+        auto &cluster = clusters[j];
+        CHECK(fields.size() == 3 + cluster.center.size() + cluster.sigma.size());
+        if (fields.size() < 3 + cluster.center.size())
+            continue;
+        CHECK(fields[0] == j + 1);
+        CHECK(fields[1] == cluster.ids.size());
+        // 最短的往返表示，读回的值与内存中的相同
+        for (size_t i = 0; i < cluster.center.size(); ++i)
+            CHECK(fields[3 + i] == cluster.center[i]);
+    }
+    CHECK(!getline(in, line));
+}
+
+int main() {
+    CHECK(output_config().prefix.empty());
+
+    char dir[] = "/tmp/isodata_test_XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+    {
+        cerr << "cannot create temporary directory" << endl;
+        return 1;
+    }
+    auto data = make_blobs(400, 4, 3, 1.0, 30, 9);
+    // 需要指数形式、整数与负数的值
+    data.push_back({1e-7, -123456789, 0.5});
+    data.push_back({2.5e12, 100, -0.000123456789});
+
+    string expect[4];
+    for (bool use_mmap : {false, true}) {
+        auto iso = make_isodata(data, iso_params{4, 4, 10, 40, 2, 2, 10}, 4);
+        auto out = quiet_output();
+        out.prefix = string(dir) + "/";
+        out.formats = OUT_MEMBERS | OUT_LABELS | OUT_LABELS_BIN | OUT_CENTERS;
+        // 小的块与多个线程，跨块的行顺序不能乱
+        out.chunk_rows = 37;
+        out.threads = 3;
+        out.use_mmap = use_mmap;
+        iso->set_output(out);
+        iso->run();
+
+        string got[4];
+        for (int f = 0; f < 4; ++f) {
+            got[f] = read_file(out.prefix + FILES[f]);
+            unlink((out.prefix + FILES[f]).c_str());
+        }
+        CHECK(got[0] == ostream_members(*iso, data));
+        auto labels = iso->labels();
+        string text;
+        for (auto l : labels)
+            text += to_string(l) + "\n";
+        CHECK(got[1] == text);
+        CHECK(got[2].size() == labels.size() * sizeof(int32_t));
+        CHECK(got[2].size() == labels.size() * sizeof(int32_t) &&
+              memcmp(got[2].data(), labels.data(), got[2].size()) == 0);
+        check_centers(got[3], *iso);
+
+        // mmap写出的文件与普通写出的相同
+        for (int f = 0; f < 4; ++f) {
+            if (use_mmap)
+                CHECK(got[f] == expect[f]);
+            else
+                expect[f] = got[f];
+        }
+    }
+    rmdir(dir);
+    return test_result("test_writer");
+}
@@ -0,0 +1,231 @@
+//
+// Created by Jeff on 2019/1/22 0022.
+//
+
+#include "writer.h"
+#include "error.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/**
+ * 追加一个浮点数
+ * @param precision 有效数字位数，与ostream相同；小于0时输出可以精确还原的最短形式
+ */
+void result_writer::append(string &buf, double v, int precision) {
+    char tmp[64];
+    auto res = precision < 0 ? to_chars(tmp, tmp + sizeof(tmp), v)
+                             : to_chars(tmp, tmp + sizeof(tmp), v, chars_format::general, precision);
+    buf.append(tmp, res.ptr);
+}
+
+void result_writer::append(string &buf, long long v) {
+    char tmp[32];
+    auto res = to_chars(tmp, tmp + sizeof(tmp), v);
+    buf.append(tmp, res.ptr);
+}
+
+unsigned result_writer::thread_count(size_t chunks) const {
+    unsigned t = cfg.threads ? cfg.threads : thread::hardware_concurrency();
+    if (t == 0)
+        t = 1;
+    return static_cast<unsigned>(min<size_t>(t, max<size_t>(chunks, 1)));
+}
+
+/**
+ * 并行格式化第first块开始的count个块，每块cfg.chunk_rows行
+ */
+void result_writer::format_chunks(size_t n, size_t first, size_t count,
+                                  const FORMATFUNC &fmt, vector<string> &bufs) const {
+    bufs.resize(count);
+    const size_t rows = max<size_t>(cfg.chunk_rows, 1);
+    atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t c = next++; c < count; c = next++) {
+            auto begin = (first + c) * rows;
+            auto end = min(n, begin + rows);
+            bufs[c].clear();
+            if (begin < end)
+                fmt(begin, end, bufs[c]);
+        }
+    };
+    auto t = thread_count(count);
+    vector<thread> pool;
+    for (unsigned i = 1; i < t; ++i)
+        pool.emplace_back(work);
+    work();
+    for (auto &th : pool)
+        th.join();
+}
+
+/**
+ * 写入文本文件
+ * @param path 文件路径
+ * @param n 总行数
+ * @param fmt 格式化函数
+ * @return 是否成功
+ */
+bool result_writer::write_text(const string &path, size_t n, const FORMATFUNC &fmt) const {
+    const size_t rows = max<size_t>(cfg.chunk_rows, 1);
+    const size_t chunks = (n + rows - 1) / rows;
+    vector<string> bufs;
+    if (cfg.use_mmap)
+    {
+        format_chunks(n, 0, chunks, fmt, bufs);
+        vector<pair<const char *, size_t>> parts;
+        for (auto &b : bufs)
+            parts.emplace_back(b.data(), b.size());
+        return write_mmap(path, parts);
+    }
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+    {
+        cout << WARN_FILE_OPEN_FAIL << endl;
+        return false;
+    }
+    setvbuf(f, nullptr, _IOFBF, 1 << 20);
+    // 每批格式化若干块后按顺序写出，内存占用不随行数增长
+    const size_t batch = max<size_t>(thread_count(chunks) * 4, 1);
+    bool good = true;
+    for (size_t first = 0; first < chunks && good; first += batch) {
+        auto count = min(batch, chunks - first);
+        format_chunks(n, first, count, fmt, bufs);
+        for (size_t c = 0; c < count && good; ++c)
+            good = fwrite(bufs[c].data(), 1, bufs[c].size(), f) == bufs[c].size();
+    }
+    if (fclose(f) != 0)
+        good = false;
+    if (!good)
+        cout << WARN_FILE_WRITE_FAIL << endl;
+    return good;
+}
+
+/**
+ * 写入二进制文件
+ */
+bool result_writer::write_binary(const string &path, const char *p, size_t size) const {
+    if (cfg.use_mmap)
+    {
+        // 按线程数切分，各线程拷贝自己的部分
+        vector<pair<const char *, size_t>> parts;
+        auto t = thread_count(size / (1 << 20) + 1);
+        auto step = (size + t - 1) / t;
+        for (size_t off = 0; off < size; off += step)
+            parts.emplace_back(p + off, min(step, size - off));
+        return write_mmap(path, parts);
+    }
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+    {
+        cout << WARN_FILE_OPEN_FAIL << endl;
+        return false;
+    }
+    bool good = fwrite(p, 1, size, f) == size;
+    if (fclose(f) != 0)
+        good = false;
+    if (!good)
+        cout << WARN_FILE_WRITE_FAIL << endl;
+    return good;
+}
+
+/**
+ * 通过mmap写入，各部分按顺序拼接，由多个线程同时拷贝
+ * 不支持mmap的平台退化为普通写入
+ */
+bool result_writer::write_mmap(const string &path, const vector<pair<const char *, size_t>> &parts) const {
+    size_t total(0);
+    vector<size_t> offsets;
+    for (auto &part : parts) {
+        offsets.push_back(total);
+        total += part.second;
+    }
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        cout << WARN_FILE_OPEN_FAIL << endl;
+        return false;
+    }
+    if (total == 0)
+    {
+        close(fd);
+        return true;
+    }
+    if (ftruncate(fd, static_cast<off_t>(total)) != 0)
+    {
+        close(fd);
+        cout << WARN_FILE_WRITE_FAIL << endl;
+        return false;
+    }
+    void *m = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED)
+    {
+        close(fd);
+        cout << WARN_FILE_WRITE_FAIL << endl;
+        return false;
+    }
+    auto dst = static_cast<char *>(m);
+    atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < parts.size(); i = next++)
+            memcpy(dst + offsets[i], parts[i].first, parts[i].second);
+    };
+    auto t = thread_count(parts.size());
+    vector<thread> pool;
+    for (unsigned i = 1; i < t; ++i)
+        pool.emplace_back(work);
+    work();
+    for (auto &th : pool)
+        th.join();
+    bool good = munmap(m, total) == 0;
+    if (close(fd) != 0)
+        good = false;
+    if (!good)
+        cout << WARN_FILE_WRITE_FAIL << endl;
+    return good;
+#else
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+    {
+        cout << WARN_FILE_OPEN_FAIL << endl;
+        return false;
+    }
+    bool good = true;
+    for (auto &part : parts)
+        good = good && fwrite(part.first, 1, part.second, f) == part.second;
+    if (fclose(f) != 0)
+        good = false;
+    if (!good)
+        cout << WARN_FILE_WRITE_FAIL << endl;
+    return good;
+#endif
+}
+
+/**
+ * 每行一个聚类编号
+ */
+bool result_writer::write_labels(const string &path, const vector<int32_t> &labels) const {
+    return write_text(path, labels.size(), [&](size_t begin, size_t end, string &buf) {
+        buf.reserve((end - begin) * 4);
+        for (size_t i = begin; i < end; ++i) {
+            append(buf, static_cast<long long>(labels[i]));
+            buf.push_back('\n');
+        }
+    });
+}
+
+/**
+ * int32的聚类编号数组，本机字节序
+ */
+bool result_writer::write_labels_binary(const string &path, const vector<int32_t> &labels) const {
+    return write_binary(path, reinterpret_cast<const char *>(labels.data()), labels.size() * sizeof(int32_t));
+}
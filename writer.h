@@ -0,0 +1,68 @@
+//
+// Created by Jeff on 2019/1/22 0022.
+//
+
+#ifndef ISODATA_WRITER_H
+#define ISODATA_WRITER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+// 输出格式，可以组合
+enum output_format : unsigned {
+    OUT_MEMBERS = 1,     // 原有格式：每个聚类的样本坐标，文件名clusters.txt
+    OUT_LABELS = 2,      // 每行一个样本所属聚类的编号，文件名labels.txt
+    OUT_LABELS_BIN = 4,  // int32的聚类编号数组，文件名labels.bin
+    OUT_CENTERS = 8      // 聚类中心与统计信息，文件名centers.txt
+};
+
+/**
+ * 输出设置
+ * 文件中的聚类编号与命令行输出一致，从1开始，0表示不属于任何聚类
+ */
+struct output_config {
+    string prefix; // 输出文件的路径前缀，缺省为空，即写到当前工作目录
+    unsigned formats; // output_format的组合
+    unsigned threads; // 格式化的线程数，0表示使用全部硬件线程
+    size_t chunk_rows; // 每个格式化块的行数
+    bool use_mmap; // 是否通过mmap写文件
+    bool print; // 是否在命令行窗口打印各聚类的中心
+    bool summary; // 是否在命令行窗口打印样本数与聚类数
+    output_config() :
+            prefix(), formats(OUT_MEMBERS), threads(0),
+            chunk_rows(1 << 16), use_mmap(false), print(true), summary(true) {}
+};
+
+/**
+ * 结果写入
+ * 文本按块并行格式化(to_chars)，再按顺序以大块写入文件；
+ * 启用mmap时先格式化全部块，确定文件大小后由各线程把自己的块拷贝到映射区域
+ */
+class result_writer {
+public:
+    // 格式化[begin, end)范围内的行，追加到buf
+    typedef function<void(size_t, size_t, string &)> FORMATFUNC;
+    explicit result_writer(const output_config &cfg) : cfg(cfg) {}
+    bool write_text(const string &path, size_t n, const FORMATFUNC &fmt) const;
+    bool write_binary(const string &path, const char *p, size_t size) const;
+    bool write_labels(const string &path, const vector<int32_t> &labels) const;
+    bool write_labels_binary(const string &path, const vector<int32_t> &labels) const;
+
+    static void append(string &buf, double v, int precision = -1);
+    static void append(string &buf, long long v);
+
+private:
+    unsigned thread_count(size_t chunks) const;
+    void format_chunks(size_t n, size_t first, size_t count, const FORMATFUNC &fmt, vector<string> &bufs) const;
+    bool write_mmap(const string &path, const vector<pair<const char *, size_t>> &parts) const;
+
+    output_config cfg;
+};
+
+
+#endif //ISODATA_WRITER_H